@@ -0,0 +1,843 @@
+//benchmarks for the solver, build with: make bench
+//  KlondikeBench [deck file]
+//    micro-benchmarks for the kernels the search spends its time in. positions are sampled from random games of the
+//    deals in the deck file (deck.txt by default) with a fixed seed so every run measures the same work. results are in ns/op.
+//  KlondikeBench --corpus [deck file] [--threshold percent] [--search-threads n] [--mem n] [--write-baseline file]
+//    solves every deal and compares it to the "138 moves (2.44 - 463,531)" comment above it. exits with 1 if a
+//    depth changed or the time or positions went up by more than the threshold (10% by default).
+//  KlondikeBench --generate [count] [seed]
+//    prints random deals, one per line, for a larger corpus. give it baselines with --corpus --write-baseline.
+//  KlondikeBench --check [deck file] [games] [seed]
+//    plays random games with one and three card draws and checks minWinAt, with the deal's pattern table added,
+//    and the hidden card counts key uses against a full scan after every move made or taken back, and the moves
+//    updateMoves gives against the loop based updateMovesScalar. then checks deals that once gave wrong results and
+//    the open list paths through nodes replaced by skip.
+//    exits with 1 on any difference.
+#define KLONDIKE_NO_MAIN
+#include "solver.cpp"
+
+const int MAX_SAMPLES = 20000;
+const int MAX_SAMPLE_MOVES = 64; //moves kept per sampled position
+
+//a sampled position along with the moves available in it
+struct Sample {
+	Position position;
+	int moveCount;
+	Move moves[MAX_SAMPLE_MOVES];
+};
+
+//a state reached by one move from a sample, used to feed the closed set the same keys the search would
+struct StreamState {
+	unsigned long long words[KEY_WORDS];
+	unsigned long long hash;
+	int value;
+
+	void key(unsigned long long* comp) {
+		memcpy(comp, words, sizeof(words));
+	}
+};
+
+Sample* samples;
+int sampleCount;
+StreamState* stream;
+int streamCount;
+volatile long long sink; //results are added here so the compiler can not drop the work being timed
+
+long long nanoTime() {
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+//read every line of the file with 156 digits on it, commented out or not
+int readDeals(const char* filename, char* deals, int maxDeals) {
+	FILE* f = fopen(filename, "r");
+	int count = 0;
+
+	if (f == NULL) {
+		return 0;
+	}
+
+	char line[1024];
+
+	while (count < maxDeals && fgets(line, sizeof(line), f) != NULL) {
+		char* deal = deals + count * 156;
+		int digits = 0;
+
+		for (char* c = line; *c != 0 && digits <= 156; ++c) {
+			if (*c >= '0' && *c <= '9') {
+				if (digits < 156) {
+					deal[digits] = *c;
+				}
+
+				++digits;
+			}
+		}
+
+		if (digits == 156) {
+			++count;
+		}
+	}
+
+	fclose(f);
+	return count;
+}
+
+//play random games of every deal and keep the positions passed through along with their moves
+void sample(Solitaire* s, char* deals, int dealCount) {
+	Random random = Random(1234);
+	MoveList list = MoveList();
+	int perGame = 100;
+	int games = MAX_SAMPLES / (dealCount * perGame) + 1;
+	samples = new Sample[MAX_SAMPLES];
+	sampleCount = 0;
+
+	for (int d = 0; d < dealCount; ++d) {
+		s->load(deals + d * 156);
+
+		for (int g = 0; g < games && sampleCount < MAX_SAMPLES; ++g) {
+			s->reset();
+
+			for (int m = 0; m < perGame && sampleCount < MAX_SAMPLES; ++m) {
+				s->updateMoves(&list);
+
+				if (list.size == 0) {
+					break;
+				}
+
+				Sample* sm = samples + sampleCount++;
+				s->savePosition(&sm->position);
+				sm->moveCount = 0;
+
+				for (Move* mv = list.first; mv != NULL && sm->moveCount < MAX_SAMPLE_MOVES; mv = mv->next) {
+					sm->moves[sm->moveCount++] = *mv;
+				}
+
+				Move* pick = list.get(random.next() % list.size);
+				s->makeMove(pick->from, pick->to, pick->cards, pick->val);
+			}
+		}
+	}
+
+	//every state one move away from a sample, in the order the search would look them up
+	stream = new StreamState[MAX_SAMPLES * 8];
+	streamCount = 0;
+
+	for (int i = 0; i < sampleCount; ++i) {
+		Sample* sm = samples + i;
+		s->restorePosition(&sm->position);
+
+		for (int j = 0; j < sm->moveCount && streamCount < MAX_SAMPLES * 8; ++j) {
+			Move* mv = sm->moves + j;
+			bool thru = s->makeMove(mv->from, mv->to, mv->cards, mv->val);
+			StreamState* st = stream + streamCount++;
+			s->key(st->words);
+			st->hash = s->closedHash();
+			st->value = s->minWinAt();
+			s->undoMove(mv->from, mv->to, mv->cards, mv->val, thru);
+		}
+	}
+}
+
+//fn does ops operations and returns the time it took. it is called until 50ms have been timed, five times over,
+//and the fastest of the five is returned in ns per op
+template <class F>
+double bench(F fn, long long ops) {
+	double best = 1e30;
+
+	for (int r = 0; r < 5; ++r) {
+		long long ns = 0;
+		int passes = 0;
+
+		while (ns < 50000000) {
+			ns += fn();
+			++passes;
+		}
+
+		best = (double)ns / passes < best ? (double)ns / passes : best;
+	}
+
+	return best / ops;
+}
+
+void report(const char* name, double ns) {
+	printf("%-28s %10.1f ns/op\n", name, ns);
+	fflush(stdout);
+}
+
+//expected result of a corpus deal, read from the comment above it
+struct Baseline {
+	int depth; //moves in the optimal solution, -1 if the deal can not be solved, 0 if not known
+	double seconds;
+	long long positions;
+};
+
+//reads "138 moves (2.44 - 463,531)", "125 (3.75 - 630,741)" or "Impossible Game - No Solution (3.49 - 710,722)"
+//after the comment marks. returns false if the line is not one of those.
+bool readBaseline(const char* line, Baseline* base) {
+	while (*line == '/' || *line == ' ') {
+		++line;
+	}
+
+	const char* open = strchr(line, '(');
+
+	if (open == NULL || strchr(open, ')') == NULL || strstr(open, " - ") == NULL) {
+		return false;
+	}
+
+	if (strstr(line, "No Solution") != NULL && strstr(line, "No Solution") < open) {
+		base->depth = -1;
+	} else if (sscanf(line, "%d", &base->depth) != 1 || base->depth <= 0) {
+		return false;
+	}
+
+	if (sscanf(open + 1, "%lf", &base->seconds) != 1) {
+		return false;
+	}
+
+	base->positions = 0;
+
+	for (const char* c = strstr(open, " - ") + 3; *c != ')' && *c != 0; ++c) {
+		if (*c >= '0' && *c <= '9') {
+			base->positions = base->positions * 10 + (*c - '0');
+		}
+	}
+
+	return true;
+}
+
+//the line with commas between groups of three digits, the way deck.txt writes positions
+void writePositions(FILE* f, long long positions) {
+	if (positions >= 1000) {
+		writePositions(f, positions / 1000);
+		fprintf(f, ",%03lld", positions % 1000);
+	} else {
+		fprintf(f, "%lld", positions);
+	}
+}
+
+void writeBaseline(FILE* f, int depth, double seconds, long long positions) {
+	if (depth < 0) {
+		fprintf(f, "//Impossible Game - No Solution (%.2f - ", seconds);
+	} else {
+		fprintf(f, "//%i moves (%.2f - ", depth, seconds);
+	}
+
+	writePositions(f, positions);
+	fprintf(f, ")\n");
+}
+
+//percent change from base to value, 0 when there is no base
+double delta(double value, double base) {
+	return base > 0 ? (value - base) * 100 / base : 0;
+}
+
+//solve every deal in the file and check it against the baseline in the comment line above it.
+//prints a JSON line per deal and a summary line, returns the number of deals whose depth changed or regressed.
+//positions are the states in the closed set. with out set the file is written back with the new results as baselines.
+int corpus(const char* filename, double threshold, int threads, int memory, const char* out) {
+	FILE* f = fopen(filename, "r");
+
+	if (f == NULL) {
+		fprintf(stderr, "Could not open %s\n", filename);
+		return -1;
+	}
+
+	FILE* baseOut = NULL;
+
+	if (out != NULL && (baseOut = fopen(out, "w")) == NULL) {
+		fprintf(stderr, "Could not open %s\n", out);
+		fclose(f);
+		return -1;
+	}
+
+	Solitaire s = Solitaire(1);
+	Baseline base = Baseline();
+	bool haveBase = false;
+	char line[1024];
+	char cardSet[156];
+	int lineNumber = 0, deals = 0, depthChanged = 0, regressions = 0;
+	double totalSeconds = 0;
+
+	while (fgets(line, sizeof(line), f) != NULL) {
+		++lineNumber;
+		int digits = 0;
+
+		for (char* c = line; *c != 0; ++c) {
+			if (*c >= '0' && *c <= '9') {
+				if (digits < 156) {
+					cardSet[digits] = *c;
+				}
+
+				++digits;
+			}
+		}
+
+		if (digits != 156) {
+			Baseline read;
+
+			//the baseline is only used by the deal on the next line
+			haveBase = readBaseline(line, &read);
+			base = read;
+
+			if (baseOut != NULL && !haveBase) {
+				fputs(line, baseOut);
+			}
+
+			continue;
+		}
+
+		if (!s.load(cardSet)) {
+			printf("{\"line\":%i,\"status\":\"invalid\"}\n", lineNumber);
+			haveBase = false;
+			continue;
+		}
+
+		++deals;
+		int moves = s.minWinAt();
+		long long start = nanoTime();
+		int found = s.solve(&moves, false, threads, memory);
+		double seconds = (nanoTime() - start) / 1e9;
+		int depth = found == 52 ? moves : -1;
+		long long positions = s.stats.closedSize;
+		bool capped = found != 52 && s.memoryFull;
+		bool depthOk = !haveBase || (!capped && base.depth == depth);
+		bool slower = haveBase && delta(seconds, base.seconds) > threshold;
+		bool morePositions = haveBase && delta(positions, base.positions) > threshold;
+		totalSeconds += seconds;
+		depthChanged += !depthOk;
+		regressions += depthOk && (slower || morePositions);
+		printf("{\"line\":%i,\"status\":\"%s\",\"depth\":%i,\"seconds\":%.3f,\"positions\":%lld", lineNumber, found == 52 ? "solved" : (capped ? "capped" : "unsolved"), depth, seconds, positions);
+
+		if (haveBase) {
+			printf(",\"baseDepth\":%i,\"baseSeconds\":%.3f,\"basePositions\":%lld,\"secondsDelta\":%.1f,\"positionsDelta\":%.1f,\"depthOk\":%s,\"regression\":%s",
+				base.depth, base.seconds, base.positions, delta(seconds, base.seconds), delta(positions, base.positions),
+				depthOk ? "true" : "false", slower || morePositions ? "true" : "false");
+		}
+
+		printf("}\n");
+		fflush(stdout);
+
+		if (baseOut != NULL) {
+			writeBaseline(baseOut, depth, seconds, positions);
+			fputs(line, baseOut);
+		}
+
+		haveBase = false;
+	}
+
+	printf("{\"summary\":true,\"deals\":%i,\"seconds\":%.3f,\"threshold\":%.1f,\"depthChanged\":%i,\"regressions\":%i,\"pass\":%s}\n",
+		deals, totalSeconds, threshold, depthChanged, regressions, depthChanged + regressions == 0 ? "true" : "false");
+	fclose(f);
+
+	if (baseOut != NULL) {
+		fclose(baseOut);
+	}
+
+	return depthChanged + regressions;
+}
+
+//print count random deals, one per line, starting from the given seed
+void generate(int count, int seed) {
+	char cardSet[157];
+	cardSet[156] = 0;
+
+	for (int i = 0; i < count; ++i) {
+		Solitaire s = Solitaire(1);
+		s.shuffle(seed + i);
+		s.save(cardSet);
+		printf("%s\n", cardSet);
+	}
+}
+
+//true if both lists have the same moves in the same order
+bool sameMoves(MoveList* list1, MoveList* list2) {
+	Move* a = list1->first, *b = list2->first;
+
+	while (a != NULL && b != NULL && a->from == b->from && a->to == b->to && a->cards == b->cards && a->val == b->val) {
+		a = a->next;
+		b = b->next;
+	}
+
+	return a == NULL && b == NULL;
+}
+
+void printMoves(MoveList* list) {
+	for (Move* mv = list->first; mv != NULL; mv = mv->next) {
+		fprintf(stderr, "[%i %i %i %i]", mv->from, mv->to, mv->cards, mv->val);
+	}
+}
+
+//play random games of every deal, taking moves back now and then, and compare the minWinAt kept up by makeMove and
+//undoMove with minWinAtScan and the moves of updateMoves with updateMovesScalar after every move. returns the number
+//of positions where they differ
+int check(const char* filename, int games, int seed) {
+	char* deals = new char[156 * 64];
+	int dealCount = readDeals(filename, deals, 64);
+	Random random = Random(seed);
+	MoveList list = MoveList(), scalar = MoveList();
+	Move* made = new Move[MAX_PATH];
+	bool* thru = new bool[MAX_PATH];
+	PatternEntry* entry = new PatternEntry();
+	PatternFile patterns = PatternFile(entry, 1);
+	Position position;
+	long long positions = 0;
+	int wrong = 0, movesWrong = 0;
+
+	for (int drawCount = 1; drawCount <= 3; drawCount += 2) {
+		Solitaire s = Solitaire(drawCount);
+
+		for (int d = 0; d < dealCount; ++d) {
+			s.load(deals + d * 156);
+			s.downCards(entry->down);
+			PatternFile::build(entry);
+			s.usePatterns(&patterns);
+
+			for (int g = 0; g < games; ++g) {
+				s.reset();
+				int depth = 0;
+
+				for (int m = 0; m < 300; ++m) {
+					s.updateMoves(&list);
+					s.updateMovesScalar(&scalar);
+
+					if (!sameMoves(&list, &scalar)) {
+						if (movesWrong < 10) {
+							fprintf(stderr, "draw %i deal %i game %i move %i: updateMoves ", drawCount, d + 1, g, m);
+							printMoves(&list);
+							fprintf(stderr, ", updateMovesScalar ");
+							printMoves(&scalar);
+							fprintf(stderr, "\n");
+						}
+
+						++movesWrong;
+					}
+
+					if (depth > 0 && (list.size == 0 || depth == MAX_PATH || random.next() % 5 == 0)) {
+						--depth;
+						s.undoMove(made[depth].from, made[depth].to, made[depth].cards, made[depth].val, thru[depth]);
+					} else if (list.size > 0) {
+						made[depth] = *list.get(random.next() % list.size);
+						thru[depth] = s.makeMove(made[depth].from, made[depth].to, made[depth].cards, made[depth].val);
+						++depth;
+					} else {
+						break;
+					}
+
+					++positions;
+					int kept = s.minWinAt(), scan = s.minWinAtScan();
+					int hidden[2] = {0, 0};
+					s.savePosition(&position);
+
+					for (int i = WASTE; i <= STOCK; ++i) {
+						Pile* pile = position.piles + i;
+
+						for (int j = 0; j < pile->size; ++j) {
+							if (i == WASTE || i == STOCK || !(pile->cards[j] & CARD_UP)) {
+								++hidden[CARD.clr[pile->cards[j]]];
+							}
+						}
+					}
+
+					if (kept != scan || hidden[0] != position.hidden[0] || hidden[1] != position.hidden[1]) {
+						if (wrong < 10) {
+							fprintf(stderr, "draw %i deal %i game %i move %i: minWinAt %i, scan %i, hidden %i %i, scan %i %i\n", drawCount, d + 1, g, m,
+								kept, scan, position.hidden[0], position.hidden[1], hidden[0], hidden[1]);
+						}
+
+						++wrong;
+					}
+				}
+			}
+		}
+	}
+
+	printf("%i deals, %lld positions, %i wrong, %i with different moves\n", dealCount, positions, wrong, movesWrong);
+	delete []deals;
+	delete []made;
+	delete []thru;
+	delete entry;
+	return wrong + movesWrong;
+}
+
+//results that once came out wrong, run by --check. returns the number that still do
+int regressions() {
+	int wrong = 0, count = 0;
+	Solitaire s = Solitaire(1);
+
+	//deal 130 of --generate 400 1000. prove called it lost because a face up card on a face up parent was taken
+	//to be stuck under its parents, though the two can move off the pile together
+	++count;
+	s.shuffle(1129);
+
+	if (s.prove() != 1) {
+		fprintf(stderr, "prove: deal 1129 can be won\n");
+		++wrong;
+	}
+
+	//a batch reuses one Deal for every line. a cache hit for a deal that cannot be won left proven set, so the
+	//next deal to stop at a limit was printed and cached as unsolvable too
+	++count;
+	char cacheName[] = "/tmp/KlondikeBenchXXXXXX";
+	int fd = mkstemp(cacheName);
+	FILE* batch = tmpfile(), *records = tmpfile();
+	SolutionCache cache;
+	char cardSet[157];
+	cardSet[156] = 0;
+
+	if (fd < 0 || batch == NULL || records == NULL || !cache.open(cacheName)) {
+		fprintf(stderr, "batch: could not make the cache and batch files\n");
+		++wrong;
+	} else {
+		SolveOptions options;
+		options.cache = &cache;
+		options.limits.nodes = 50;
+		options.output = records;
+		CacheRecord record = CacheRecord();
+		record.status = CACHE_UNSOLVABLE;
+		s.shuffle(1);
+		cache.add(s.dealCards(), 1, &record);
+		s.save(cardSet);
+		fprintf(batch, "%s\n", cardSet);
+		s.shuffle(2);
+		s.save(cardSet);
+		fprintf(batch, "%s\n", cardSet);
+		rewind(batch);
+		solveBatch(batch, 1, &options);
+		rewind(records);
+		char status[2][16];
+		int line[2];
+
+		if (fscanf(records, "%i %15s %*[^\n]", &line[0], status[0]) != 2 || fscanf(records, "%i %15s", &line[1], status[1]) != 2
+				|| line[0] != 1 || strcmp(status[0], "unsolvable") != 0 || line[1] != 2 || strcmp(status[1], "limit") != 0) {
+			fprintf(stderr, "batch: expected deal 1 unsolvable from the cache and deal 2 stopped at the limit\n");
+			++wrong;
+		}
+
+		if (cache.find(s.dealCards(), 1, &record)) {
+			fprintf(stderr, "batch: a deal stopped at a limit was cached\n");
+			++wrong;
+		}
+	}
+
+	//a cache only read its file when it was opened, so records another process appended later were never found
+	++count;
+	SolutionCache reader, writer;
+
+	if (fd < 0 || !reader.open(cacheName) || !writer.open(cacheName)) {
+		fprintf(stderr, "cache: could not open the cache file twice\n");
+		++wrong;
+	} else {
+		CacheRecord record = CacheRecord();
+		record.status = CACHE_SOLVED;
+		record.moves = 100;
+		s.shuffle(3);
+		writer.add(s.dealCards(), 1, &record);
+
+		if (!reader.find(s.dealCards(), 1, &record) || record.moves != 100) {
+			fprintf(stderr, "cache: a record appended by another cache was not found\n");
+			++wrong;
+		}
+	}
+
+	//a full closed set stopped keeping states, so every position after that was searched as if never seen. evict
+	//makes room by dropping the states with the most moves and has to leave the rest where they are still found
+	++count;
+	ClosedSet closed = ClosedSet(10, sizeof(ClosedSlot) << 10);
+	StreamState* states = new StreamState[1024];
+	int kept = 0, dropped = 0, lost = 0, lowestLost = 100, highestFound = 0;
+
+	for (int i = 0; i < 1024; ++i) {
+		unsigned long long h = (i + 1) * 0x9e3779b97f4a7c15ULL;
+		h = (h ^ (h >> 31)) * 0xbf58476d1ce4e5b9ULL;
+		states[i].words[0] = i;
+		states[i].words[1] = 0;
+		states[i].words[2] = 0;
+		states[i].hash = h ^ (h >> 29);
+		states[i].value = i % 100;
+		kept += closed.addLower(states + i, states[i].hash, states[i].value) == CLOSED_ADDED;
+	}
+
+	int evicted = closed.evict();
+
+	//states are looked for in the order of their moves so the kept ones come before the evicted ones are added back
+	for (int value = 0; value < 100; ++value) {
+		for (int i = value; i < kept; i += 100) {
+			int result = closed.addLower(states + i, states[i].hash, states[i].value);
+			dropped += result == CLOSED_DROPPED;
+
+			if (result == CLOSED_SEEN) {
+				highestFound = value > highestFound ? value : highestFound;
+			} else {
+				++lost;
+				lowestLost = value < lowestLost ? value : lowestLost;
+			}
+		}
+	}
+
+	if (!closed.isFull() || evicted != (kept + 3) / 4 || lost != evicted || lowestLost < highestFound || dropped != 0 || closed.size() != kept) {
+		fprintf(stderr, "closed: %i states kept, %i evicted, %i not found after it with %i moves or more, %i found with up to %i, %i dropped\n",
+			kept, evicted, lost, lowestLost, kept - lost, highestFound, dropped);
+		++wrong;
+	}
+
+	delete []states;
+
+	//a shorter path to an expanded node adds a new node for it and turns the old one into a link, so the old node's
+	//children have to come out on the shorter path. the moves here are only labels, the paths are not played
+	++count;
+	MoveArray open = MoveArray(16);
+	open.add(-1, -1, -1, 0);
+	int root = open.holdFirst();
+	open.heldToLast(root);
+	int longer = open.addHeld(1, 2, 1, 0, root);
+	open.heldToLast(longer);
+	int child = open.addHeld(3, 4, 1, 0, longer);
+	open.heldToLast(child);
+	int shorter = open.addHeld(5, 6, 1, 0, root);
+	open.heldToLast(shorter);
+	int fresh = open.addHeld(1, 2, 1, 0, shorter);
+	open.skip(longer, fresh);
+	int expected[4][2] = {{3, 4}, {1, 2}, {5, 6}, {-1, -1}}, steps = 0;
+	bool pathOk = true;
+
+	for (Move* mv = open.get(child); mv != NULL; mv = mv->prev) {
+		if (mv->cards != MoveArray::SKIP) {
+			pathOk &= steps < 4 && mv->from == expected[steps][0] && mv->to == expected[steps][1];
+			++steps;
+		}
+	}
+
+	if (!pathOk || steps != 4) {
+		fprintf(stderr, "skip: the child of a skipped node did not follow the shorter path\n");
+		++wrong;
+	}
+
+	//and a search that skips has to give a solution that plays out to the end in the moves it says. the solution
+	//is played move by move, every move but a turned over card has to be one updateMoves gives for its position
+	++count;
+	Solitaire search = Solitaire(3), replay = Solitaire(3);
+	SolveLimits limits = SolveLimits();
+	limits.nodes = 200000;
+	search.shuffle(18);
+	replay.shuffle(18);
+	int moves = search.minWinAt();
+	long long skipped = 0;
+	search.solve(&moves, false, 1, 0, &limits);
+
+	for (int i = 0; i < search.stats.count; ++i) {
+		skipped += search.stats.iterations[i].skipped;
+	}
+
+	int played = 0, illegal = 0;
+	MoveList available = MoveList();
+
+	for (Move* mv = search.solution.first; mv != NULL && search.result.moves >= 0; mv = mv->next) {
+		replay.updateMoves(&available);
+		bool found = mv->from == mv->to && mv->cards == 0;
+		int face = available.first != NULL ? available.first->from : -1;
+
+		//updateMoves only gives the turn of a face down card while there is one, the search can play
+		//another auto move first so the moves are looked for with the card turned
+		if (!found && available.size == 1 && available.first->to == face) {
+			bool thru = replay.makeMove(face, face, 0, 0);
+			replay.updateMoves(&available);
+			replay.undoMove(face, face, 0, 0, thru);
+		}
+
+		for (Move* legal = available.first; legal != NULL && !found; legal = legal->next) {
+			found = legal->from == mv->from && legal->to == mv->to && legal->cards == mv->cards && legal->val == mv->val;
+		}
+
+		illegal += !found;
+		played += replay.drawCost(mv->val) + 1;
+		replay.makeMove(mv->from, mv->to, mv->cards, mv->val);
+	}
+
+	if (search.result.moves < 0 || skipped == 0 || illegal > 0 || played != search.result.moves || replay.minWinAt() != 0) {
+		fprintf(stderr, "skip: deal 18 draw 3 with %lld skips gave %i moves, %i illegal, %i played and %i cards left\n",
+			skipped, search.result.moves, illegal, played, replay.minWinAt());
+		++wrong;
+	}
+
+	if (batch != NULL) {
+		fclose(batch);
+	}
+
+	if (records != NULL) {
+		fclose(records);
+	}
+
+	if (fd >= 0) {
+		close(fd);
+		unlink(cacheName);
+	}
+
+	printf("%i regressions, %i wrong\n", count, wrong);
+	return wrong;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc > 1 && strcmp(argv[1], "--generate") == 0) {
+		generate(argc > 2 ? atoi(argv[2]) : 100, argc > 3 ? atoi(argv[3]) : 1);
+		return 0;
+	}
+
+	if (argc > 1 && strcmp(argv[1], "--check") == 0) {
+		const char* filename = argc > 2 ? argv[2] : "deck.txt";
+		int wrong = check(filename, argc > 3 ? atoi(argv[3]) : 100, argc > 4 ? atoi(argv[4]) : 1) + regressions();
+		return wrong == 0 ? 0 : 1;
+	}
+
+	if (argc > 1 && strcmp(argv[1], "--corpus") == 0) {
+		const char* filename = "deck.txt", *out = NULL;
+		double threshold = 10;
+		int threads = 1, memory = 0;
+
+		for (int i = 2; i < argc; ++i) {
+			if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+				threshold = atof(argv[++i]);
+			} else if (strcmp(argv[i], "--search-threads") == 0 && i + 1 < argc) {
+				threads = atoi(argv[++i]);
+			} else if (strcmp(argv[i], "--mem") == 0 && i + 1 < argc) {
+				memory = atoi(argv[++i]);
+			} else if (strcmp(argv[i], "--write-baseline") == 0 && i + 1 < argc) {
+				out = argv[++i];
+			} else {
+				filename = argv[i];
+			}
+		}
+
+		int failed = corpus(filename, threshold, threads, memory, out);
+		return failed == 0 ? 0 : 1;
+	}
+
+	const char* filename = argc > 1 ? argv[1] : "deck.txt";
+	char* deals = new char[156 * 64];
+	int dealCount = readDeals(filename, deals, 64);
+
+	if (dealCount == 0) {
+		fprintf(stderr, "No deals found in %s\n", filename);
+		return -1;
+	}
+
+	Solitaire s = Solitaire(1);
+	sample(&s, deals, dealCount);
+	long long moveCount = 0;
+
+	for (int i = 0; i < sampleCount; ++i) {
+		moveCount += samples[i].moveCount;
+	}
+
+	printf("%i deals, %i positions, %lld moves, %i child states\n", dealCount, sampleCount, moveCount, streamCount);
+	MoveList list = MoveList();
+	unsigned long long key[KEY_WORDS];
+
+	//restoring a position is part of every loop below, it is timed on its own and taken off the others
+	double restore = bench([&]() {
+		long long start = nanoTime();
+
+		for (int i = 0; i < sampleCount; ++i) {
+			s.restorePosition(&samples[i].position);
+		}
+
+		return nanoTime() - start;
+	}, sampleCount);
+	report("restorePosition", restore);
+
+	report("updateMoves", bench([&]() {
+		long long start = nanoTime();
+
+		for (int i = 0; i < sampleCount; ++i) {
+			s.restorePosition(&samples[i].position);
+			s.updateMoves(&list);
+			sink += list.size;
+		}
+
+		return nanoTime() - start;
+	}, sampleCount) - restore);
+
+	report("key", bench([&]() {
+		long long start = nanoTime();
+
+		for (int i = 0; i < sampleCount; ++i) {
+			s.restorePosition(&samples[i].position);
+			s.key(key);
+			sink += key[0] ^ key[1] ^ key[2];
+		}
+
+		return nanoTime() - start;
+	}, sampleCount) - restore);
+
+	report("minWinAt", bench([&]() {
+		long long start = nanoTime();
+
+		for (int i = 0; i < sampleCount; ++i) {
+			s.restorePosition(&samples[i].position);
+			sink += s.minWinAt();
+		}
+
+		return nanoTime() - start;
+	}, sampleCount) - restore);
+
+	report("makeMove+undoMove", bench([&]() {
+		long long start = nanoTime();
+
+		for (int i = 0; i < sampleCount; ++i) {
+			Sample* sm = samples + i;
+			s.restorePosition(&sm->position);
+
+			for (int j = 0; j < sm->moveCount; ++j) {
+				Move* mv = sm->moves + j;
+				bool thru = s.makeMove(mv->from, mv->to, mv->cards, mv->val);
+				s.undoMove(mv->from, mv->to, mv->cards, mv->val, thru);
+			}
+		}
+
+		return nanoTime() - start - (long long)(restore * sampleCount);
+	}, moveCount));
+
+	//closed set lookups: the first pass over the stream mostly adds, the second only finds
+	ClosedSet closed = ClosedSet(16);
+	report("ClosedSet::addLower new", bench([&]() {
+		closed.clear();
+		long long start = nanoTime();
+
+		for (int i = 0; i < streamCount; ++i) {
+			sink += closed.addLower(stream + i, stream[i].hash, stream[i].value);
+		}
+
+		return nanoTime() - start;
+	}, streamCount));
+
+	report("ClosedSet::addLower seen", bench([&]() {
+		long long start = nanoTime();
+
+		for (int i = 0; i < streamCount; ++i) {
+			sink += closed.addLower(stream + i, stream[i].hash, stream[i].value);
+		}
+
+		return nanoTime() - start;
+	}, streamCount));
+
+	//an open list holding one move per child state with the sort keys the search gives them.
+	//nothing is marked used so every prune keeps every move and sorts them all again.
+	MoveArray open = MoveArray(streamCount + 1);
+
+	for (int i = 0; i < streamCount; ++i) {
+		Position* p = &samples[i % sampleCount].position;
+		open.add(0, 1, 1, ((52 - p->foundationCount + p->rounds) << 6) | (i % 24));
+	}
+
+	report("MoveArray::prune (per move)", bench([&]() {
+		long long start = nanoTime();
+		open.prune();
+		sink += open.top;
+		return nanoTime() - start;
+	}, streamCount));
+
+	delete []deals;
+	delete []samples;
+	delete []stream;
+	return 0;
+}
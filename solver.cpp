@@ -22,10 +22,22 @@
 * OTHER DEALINGS IN THE SOFTWARE.
 */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <atomic>
+#include <algorithm>
 #include <time.h>
 #include <sys/timeb.h>
+#include <sys/resource.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 const char RANKS[] = {"A23456789TJQK"};
+const int MAX_PATH = 512; //more than the number of moves allowed in a solution
 const char SUITS[] = {"CDSH"};
 
 enum Piles {
@@ -44,138 +56,459 @@ enum Piles {
 	FOUNDATION4
 };
 
-//Key value pair used in HashMap
-struct Pair {
-	int value, hash;
-	char* key;
-	Pair* next;
+//64 bit words in a game key. the key is a bit string of
+//waste size (5 bits), foundation sizes (4 bits each) and the number of tableau piles with face up cards (3 bits)
+//followed by the face up run of each of those piles: the lowest card (6 bits), the run length - 1 (4 bits)
+//and one bit per card above it telling which of the two suits of the right color it is.
+//at most 24 + 7 * 10 + 45 bits are used, unused bits are 0, so the last word is below 1 << 11
+const int KEY_WORDS = 3;
+
+//what ClosedSet::addLower did with a state. everything but CLOSED_SEEN means the state should be searched
+enum ClosedResult {
+	CLOSED_SEEN = 0, //already there with the same or fewer moves
+	CLOSED_ADDED,
+	CLOSED_LOWERED, //already there with more moves
+	CLOSED_DROPPED //not there and the set is full, see ClosedSet::evict
+};
 
-	Pair() {
-		key = NULL;
-		value = -1;
-		hash = -1;
-		next = NULL;
-	}
-	Pair(char* key, int value, int hash, Pair* next) {
-		this->key = key;
-		this->value = value;
-		this->next = next;
-		this->hash = hash;
-	}
+//slot in a ClosedSet table, two to a cache line. state is 0 while the slot is free,
+//1 while a thread is writing the key and part of the hash of the key once it can be read. the slot's place in its
+//table comes from that part too, so the states can be moved when some are evicted.
+//the last key word only needs 11 bits, the rest of last links the state to the open list, see ClosedSet::node
+struct alignas(32) ClosedSlot {
+	std::atomic<unsigned int> state;
+	std::atomic<int> value;
+	unsigned long long key[KEY_WORDS - 1];
+	std::atomic<unsigned long long> last;
+
+	ClosedSlot() : state(0), value(-1), last(0) {}
 };
 
-class HashMap {
+//a used ClosedSlot as a checkpoint file holds it
+struct SavedSlot {
+	unsigned int index, state;
+	int value;
+	unsigned long long key[KEY_WORDS];
+};
+
+//closed set shared by every thread searching a deal. maps a game key to the fewest moves it has been reached in.
+//uses open addressing with linear probing on the game's hash and keeps keys in the slots so adding a key never allocates.
+//slots are claimed with a compare and swap so no lock is needed.
+//instead of rehashing when a table gets full a new table twice the size is added and the old ones are still searched.
+//when adding a table would go over the memory limit the set is full: once the last table is as full as it gets new
+//states are treated as never seen, so the search only loses duplicate detection and still finds the same solution,
+//and the searcher calls evict to make room for more.
+class ClosedSet {
 	private:
-		Pair* table;
-		int capacity, shift, spacesUsed;
-
-		static int equals(char* key1, char* key2) {
-			while(*key1 != 0 && *key2 != 0 && *key1++ == *key2++) {}
-			return *key1 == 0 && *key2 == 0;
-		}
-		void resize(int newShift) {
-			shift = newShift;
-			Pair* old = table;
-			Pair* temp = table;
-			table = new Pair[1 << shift];
-			int oldCap = capacity;
-			capacity = (1 << shift) - 1;
-			count = 0;
-			spacesUsed = 0;
+		static const int MAX_LEVELS = 16;
+
+		struct Level {
+			ClosedSlot* slots;
+			unsigned int mask;
+			int limit; //a new level is added once count reaches this
+			std::atomic<int> count;
+
+			Level(int shift) : count(0) {
+				slots = new ClosedSlot[1 << shift];
+				mask = (1 << shift) - 1;
+				limit = (1 << shift) - (1 << (shift - 2));
+			}
+			~Level() {
+				delete []slots;
+			}
+		};
+
+		std::atomic<Level*> levels[MAX_LEVELS];
+		std::atomic<int> levelCount, count;
+		std::atomic<bool> full;
+		std::atomic<bool> crowded; //a state was dropped since the last evict
+		long long bytes, maxBytes; //memory used by the tables and the most they may use, 0 for no limit
+		int shift;
+
+		//ClosedSlot::last holds the last key word, the depth bound the link was made in, the arrangement of the
+		//linked position and the open list node plus one, 0 for no link
+		static const int BOUND_SHIFT = 11, ARRANGEMENT_SHIFT = 20, NODE_SHIFT = 35;
+		static const unsigned long long KEY_MASK = (1ULL << BOUND_SHIFT) - 1;
+
+		static bool equals(const ClosedSlot* slot, const unsigned long long* key) {
+			return slot->key[0] == key[0] && slot->key[1] == key[1] && (slot->last.load(std::memory_order_relaxed) & KEY_MASK) == key[2];
+		}
+		static void setKey(ClosedSlot* slot, const unsigned long long* key) {
+			slot->key[0] = key[0];
+			slot->key[1] = key[1];
+			slot->last.store(key[2], std::memory_order_relaxed);
+		}
+		//the hash tag kept in a slot's state, never 0 or 1
+		static unsigned int tag(unsigned long long hash) {
+			unsigned int tag = (unsigned int)(hash >> 32);
+			return tag > 1 ? tag : tag + 2;
+		}
+		//returns the slot holding the game's state or NULL if it is not in the level.
+		//slots are matched on part of the hash and the game's key is only made once a slot needs it.
+		//when insert is set a missing state is put in the first free slot and claimed is set.
+		//probes is increased by the number of slots looked at.
+		template <class Game>
+		static ClosedSlot* find(Level* level, Game* game, unsigned long long hash, unsigned long long* key, bool* haveKey, int value, bool insert, bool* claimed, int* probes) {
+			unsigned int tag = ClosedSet::tag(hash);
+			unsigned int i = tag & level->mask;
+
+			while (true) {
+				ClosedSlot* slot = level->slots + i;
+				++*probes;
+				unsigned int cur = slot->state.load(std::memory_order_acquire);
+
+				if (cur == 0) {
+					if (!insert) {
+						return NULL;
+					}
 
-			for (int j = 0; j <= oldCap; ++j, ++temp) {
-				if (temp->key != NULL) {
-					Pair* next = temp;
-					while(next != NULL) {
-						addGet(next->key,next->value);
-						next = next->next;
+					if (!*haveKey) {
+						game->key(key);
+						*haveKey = true;
 					}
-				}
-			}
 
-			clear(old, oldCap, false);
-			delete[] old;
-		}
-		void clear(Pair* oldTable, int oldCap, bool del) {
-			Pair* temp = oldTable + oldCap;
-			Pair* next, *tmp;
+					if (slot->state.compare_exchange_strong(cur, 1, std::memory_order_acquire)) {
+						setKey(slot, key);
+						slot->value.store(value, std::memory_order_relaxed);
+						slot->state.store(tag, std::memory_order_release);
+						*claimed = true;
+						return slot;
+					}
+				}
 
-			while(temp >= oldTable) {
-				if (temp->key != NULL) {
-					tmp = temp->next;
+				//another thread claimed the slot but has not stored its key yet
+				while (cur == 1) {
+					cur = slot->state.load(std::memory_order_acquire);
+				}
 
-					while (tmp != NULL) {
-						if (del) { delete []tmp->key; }
-						next = tmp->next;
-						delete tmp;
-						tmp = next;
+				if (cur == tag) {
+					if (!*haveKey) {
+						game->key(key);
+						*haveKey = true;
 					}
 
-					if (del) { delete []temp->key; }
-					temp->key = NULL;
-					temp->next = NULL;
+					if (equals(slot, key)) {
+						return slot;
+					}
 				}
-				--temp;
+
+				i = (i + 1) & level->mask;
 			}
 		}
-	public:
-		int count;
+		//add the next table or mark the set full if there is no room left for it
+		void grow(int index) {
+			long long size = (long long)sizeof(ClosedSlot) << (shift + index + 1);
 
-		HashMap(int shft) {
-			count = 0;
+			if (index + 1 >= MAX_LEVELS || (maxBytes > 0 && bytes + size > maxBytes)) {
+				full.store(true, std::memory_order_relaxed);
+				return;
+			}
+
+			Level* next = new Level(shift + index + 1);
+			Level* expected = NULL;
+
+			if (!levels[index + 1].compare_exchange_strong(expected, next)) {
+				delete next;
+				return;
+			}
+
+			bytes += size;
+			++levelCount;
+		}
+	public:
+		ClosedSet(int shft, long long maxBytes = 0) {
 			shift = shft;
-			spacesUsed = 0;
-			capacity = (1 << shift) - 1;
-			table = new Pair[capacity + 1];
+			count = 0;
+			full = false;
+			crowded = false;
+			levelCount = 1;
+			levels[0] = new Level(shift);
+			bytes = (long long)sizeof(ClosedSlot) << shift;
+			this->maxBytes = maxBytes;
+
+			for (int i = 1; i < MAX_LEVELS; ++i) {
+				levels[i] = NULL;
+			}
 		}
-		~HashMap() {
-			clear(table, capacity, true);
-			delete []table;
+		~ClosedSet() {
+			for (int l = levelCount - 1; l >= 0; --l) {
+				delete levels[l].load();
+			}
 		}
 
 		int size() {
 			return count;
 		}
+		//true once the memory limit stopped the set from adding tables
+		bool isFull() {
+			return full.load(std::memory_order_relaxed);
+		}
+		//true once a state was dropped for want of room, evict makes some
+		bool needsEviction() {
+			return crowded.load(std::memory_order_relaxed);
+		}
+		//make room in a full set by evicting the quarter of the states in its last table reached in the most moves.
+		//they count as never seen after that, so they are searched again. the states left are moved up into the
+		//freed slots on their probe paths. only while no thread is using the set, returns the number of states evicted
+		int evict() {
+			Level* level = levels[levelCount - 1];
+			int histogram[MAX_PATH];
+			unsigned int start = 0;
+			memset(histogram, 0, sizeof(histogram));
+
+			for (unsigned int i = 0; i <= level->mask; ++i) {
+				ClosedSlot* slot = level->slots + i;
+
+				if (slot->state.load(std::memory_order_relaxed) == 0) {
+					start = i;
+				} else {
+					int value = slot->value.load(std::memory_order_relaxed);
+					++histogram[value < MAX_PATH - 1 ? value : MAX_PATH - 1];
+				}
+			}
+
+			//every state with more moves than most goes and as many with most as it takes to reach the target
+			int target = (level->count + 3) / 4, most = MAX_PATH - 1, above = 0, evicted = 0;
+
+			while (most > 0 && above + histogram[most] < target) {
+				above += histogram[most--];
+			}
+
+			int atMost = target - above;
+
+			//no probe path runs past a slot that was free, so going round the table from one moves every state
+			//to the first free slot on its path without opening a gap in the path of one already done
+			for (unsigned int n = 1; n <= level->mask + 1; ++n) {
+				unsigned int i = (start + n) & level->mask;
+				ClosedSlot* slot = level->slots + i;
+				unsigned int state = slot->state.load(std::memory_order_relaxed);
+
+				if (state == 0) {
+					continue;
+				}
+
+				int value = slot->value.load(std::memory_order_relaxed);
+				value = value < MAX_PATH - 1 ? value : MAX_PATH - 1;
+
+				if (evicted < target && (value > most || (value == most && atMost-- > 0))) {
+					slot->state.store(0, std::memory_order_relaxed);
+					++evicted;
+					continue;
+				}
+
+				unsigned int j = state & level->mask;
+
+				while (j != i && level->slots[j].state.load(std::memory_order_relaxed) != 0) {
+					j = (j + 1) & level->mask;
+				}
+
+				if (j != i) {
+					ClosedSlot* to = level->slots + j;
+					to->key[0] = slot->key[0];
+					to->key[1] = slot->key[1];
+					to->last.store(slot->last.load(std::memory_order_relaxed), std::memory_order_relaxed);
+					to->value.store(slot->value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+					to->state.store(state, std::memory_order_relaxed);
+					slot->state.store(0, std::memory_order_relaxed);
+				}
+			}
+
+			level->count -= evicted;
+			count -= evicted;
+			crowded = false;
+			return evicted;
+		}
+		//number of tables, one more than the number of times the set has grown
+		int levelsUsed() {
+			return levelCount;
+		}
+		//bytes used by the tables
+		long long memory() {
+			return bytes;
+		}
+		//empty the set keeping only the first table
 		void clear() {
-			clear(table, capacity, true);
+			for (int l = levelCount - 1; l > 0; --l) {
+				delete levels[l].load();
+				levels[l] = NULL;
+			}
+
+			Level* level = levels[0];
+
+			for (unsigned int i = 0; i <= level->mask; ++i) {
+				level->slots[i].state.store(0, std::memory_order_relaxed);
+			}
+
+			level->count = 0;
+			levelCount = 1;
+			count = 0;
+			full = false;
+			crowded = false;
+			bytes = (long long)sizeof(ClosedSlot) << shift;
+		}
+		//write the used slots of every table to a checkpoint file, only while no thread is adding to the set
+		bool save(FILE* f) {
+			int header[3] = {levelCount, count, full};
+			bool written = fwrite(header, sizeof(header), 1, f) == 1;
+
+			for (int l = 0; l < levelCount && written; ++l) {
+				Level* level = levels[l];
+				int info[2] = {shift + l, level->count};
+				written = fwrite(info, sizeof(info), 1, f) == 1;
+
+				for (unsigned int i = 0; i <= level->mask && written; ++i) {
+					ClosedSlot* slot = level->slots + i;
+					SavedSlot saved;
+					saved.state = slot->state.load(std::memory_order_relaxed);
+
+					if (saved.state != 0) {
+						saved.index = i;
+						saved.value = slot->value.load(std::memory_order_relaxed);
+						saved.key[0] = slot->key[0];
+						saved.key[1] = slot->key[1];
+						saved.key[2] = slot->last.load(std::memory_order_relaxed) & KEY_MASK;
+						written = fwrite(&saved, sizeof(saved), 1, f) == 1;
+					}
+				}
+			}
+
+			return written;
+		}
+		//replace the set with one written by save, false if the file is cut short or its tables do not fit the
+		//size and memory limit this set was made with. the set has to be cleared before it is used after that
+		bool load(FILE* f) {
+			int header[3];
+			clear();
+
+			if (fread(header, sizeof(header), 1, f) != 1 || header[0] < 1 || header[0] > MAX_LEVELS) {
+				return false;
+			}
+
+			for (int l = 0; l < header[0]; ++l) {
+				int info[2];
+
+				if (fread(info, sizeof(info), 1, f) != 1 || info[0] != shift + l) {
+					return false;
+				}
+
+				if (l > 0) {
+					long long size = (long long)sizeof(ClosedSlot) << info[0];
+
+					if (maxBytes > 0 && bytes + size > maxBytes) {
+						return false;
+					}
+
+					levels[l] = new Level(info[0]);
+					bytes += size;
+					levelCount = l + 1;
+				}
+
+				Level* level = levels[l];
+
+				for (int i = 0; i < info[1]; ++i) {
+					SavedSlot saved;
+
+					if (fread(&saved, sizeof(saved), 1, f) != 1 || saved.index > level->mask || saved.state < 2) {
+						return false;
+					}
+
+					ClosedSlot* slot = level->slots + saved.index;
+					slot->state.store(saved.state, std::memory_order_relaxed);
+					slot->value.store(saved.value, std::memory_order_relaxed);
+					setKey(slot, saved.key);
+				}
+
+				level->count = info[1];
+			}
+
+			count = header[1];
+			full = header[2] != 0;
+			return true;
 		}
-		Pair* addGet(char* key, int value) {
-			int hash = 0x55555555;
-			int sft = 0;
-			char* temp = key;
+		//add the game's state with the given number of moves or lower the moves of an existing one.
+		//hash has to be the same for every game with the same key.
+		//returns a ClosedResult, CLOSED_SEEN (0) unless the state should be searched.
+		//if probes is given it is set to the number of slots looked at.
+		//if found is given it is set to the state's slot, NULL when it was dropped
+		template <class Game>
+		int addLower(Game* game, unsigned long long hash, int value, int* probes = NULL, ClosedSlot** found = NULL) {
+			unsigned long long key[KEY_WORDS];
+			int levelsUsed = levelCount.load(std::memory_order_acquire);
+			bool haveKey = false, claimed = false;
+			ClosedSlot* slot = NULL;
+			int looked = 0;
+			probes = probes != NULL ? probes : &looked;
+			*probes = 0;
+
+			for (int l = 0; l < levelsUsed - 1 && slot == NULL; ++l) {
+				slot = find(levels[l].load(), game, hash, key, &haveKey, value, false, &claimed, probes);
+			}
+
+			if (slot == NULL) {
+				//a full set keeps adding to its last table until that is as full as a table gets before the next is added
+				Level* level = levels[levelsUsed - 1];
+				bool room = !full.load(std::memory_order_relaxed) || level->count.load(std::memory_order_relaxed) < level->limit;
+				slot = find(level, game, hash, key, &haveKey, value, room, &claimed, probes);
+
+				if (found != NULL) {
+					*found = slot;
+				}
+
+				if (claimed) {
+					++count;
 
-			while ((*temp) != 0) {
-				hash ^= ((*temp) << sft) ^ sft;
+					if (++level->count == level->limit) {
+						grow(levelsUsed - 1);
+					}
 
-				if ((++sft) >= shift) {
-					sft = 0;
+					return CLOSED_ADDED;
 				}
 
-				++temp;
+				if (slot == NULL) {
+					crowded.store(true, std::memory_order_relaxed);
+					return CLOSED_DROPPED;
+				}
+			} else if (found != NULL) {
+				*found = slot;
 			}
 
-			int i = hash & capacity;
-			Pair* e = table + i;
+			int cur = slot->value.load(std::memory_order_relaxed);
 
-			while (e != NULL && e->key != NULL) {
-				if (e->hash == hash && equals(e->key, key)) {
-					delete []key;
-					return e;
+			while (cur > value) {
+				if (slot->value.compare_exchange_weak(cur, value, std::memory_order_relaxed)) {
+					return CLOSED_LOWERED;
 				}
-				e = e->next;
 			}
-			++count;
-			e = table + i;
-			e->next = e->key != NULL ? new Pair(e->key, e->value, e->hash, e->next) : NULL;
-			if (e->next == NULL) { ++spacesUsed; }
-			e->value = value;
-			e->hash = hash;
-			e->key = key;
 
-			if (spacesUsed > (capacity >> 1) && (count >> 1) > spacesUsed) {
-				resize(shift + 1);
+			return CLOSED_SEEN;
+		}
+		//the fewest moves the state of a slot has been reached in
+		static int moves(ClosedSlot* slot) {
+			return slot->value.load(std::memory_order_relaxed);
+		}
+		//the open list node set for a slot's state during the given depth bound, -1 if there is none. nodes are
+		//only freed when the open list is pruned for the next bound so a node set in the current one is still the state's.
+		//positions that share a key can have their runs on other piles or suits traded, so the node is only given for
+		//the same arrangement, see Solitaire::arrangement
+		static int node(ClosedSlot* slot, int bound, int arrangement) {
+			unsigned long long last = slot->last.load(std::memory_order_relaxed);
+
+			if ((last >> BOUND_SHIFT & 511) != (unsigned int)bound || (last >> ARRANGEMENT_SHIFT & 32767) != (unsigned int)arrangement) {
+				return -1;
 			}
-			return NULL;
+
+			return (int)(last >> NODE_SHIFT) - 1;
+		}
+		//link a slot to an open list node, nodes past what the link has room for are left unlinked
+		static void setNode(ClosedSlot* slot, int node, int bound, int arrangement) {
+			unsigned long long last = slot->last.load(std::memory_order_relaxed) & KEY_MASK;
+
+			if (node + 1 < 1 << (64 - NODE_SHIFT)) {
+				last |= (unsigned long long)bound << BOUND_SHIFT | (unsigned long long)arrangement << ARRANGEMENT_SHIFT
+					| (unsigned long long)(node + 1) << NODE_SHIFT;
+			}
+
+			slot->last.store(last, std::memory_order_relaxed);
 		}
 };
 
@@ -223,65 +556,120 @@ class Random {
 		}
 };
 
-struct Card {
-	int rank, suit, clr, odd, value, up;
+//random numbers used to hash a game. ZOBRIST_CARD[card][card under it] is used for every face up tableau card,
+//with 52 standing for a face down card or an empty spot, and ZOBRIST_SIZE[pile][size] for the waste and foundations
+unsigned long long ZOBRIST_CARD[52][53];
+unsigned long long ZOBRIST_SIZE[13][25];
 
-	Card() {
-		value = -1;
-		rank = -1;
-		suit = -1;
-		up = 1;
-		clr = 0;
-		odd = 0;
-	}
-	Card(int hash) {
-		value = hash;
-		rank = hash % 13;
-		suit = hash / 13;
-		up = 0;
-		clr = suit & 1;
-		odd = rank & 1;
+struct ZobristInit {
+	ZobristInit() {
+		Random random = Random(52);
+
+		for (int i = 0; i < 52; ++i) {
+			for (int j = 0; j < 53; ++j) {
+				ZOBRIST_CARD[i][j] = next(&random);
+			}
+		}
+
+		for (int i = 0; i < 13; ++i) {
+			for (int j = 0; j < 25; ++j) {
+				ZOBRIST_SIZE[i][j] = next(&random);
+			}
+		}
 	}
-	void set(int hash) {
-		value = hash;
-		rank = hash % 13;
-		suit = hash / 13;
-		up = 0;
-		clr = suit & 1;
-		odd = rank & 1;
+	static unsigned long long next(Random* random) {
+		unsigned long long value = random->next();
+		value = (value << 31) ^ random->next();
+		return (value << 31) ^ random->next();
 	}
-	void print() const {
-		printf("%c%c%c", (up ? '+' : '-'), (rank >= 0 ? RANKS[rank] : 'X'), (suit >= 0 ? SUITS[suit] : 'X'));
-		fflush(stdout);
+} zobristInit;
+
+//a card is stored in one byte. the low 6 bits are its value (suit * 13 + rank) and CARD_UP is set while it is face up
+typedef unsigned char Card;
+
+enum CardBits {
+	CARD_VALUE = 63,
+	CARD_UP = 64
+};
+
+//rank, suit, color and rank parity of every card byte, face up or not
+struct CardTables {
+	signed char rank[128], suit[128], clr[128], odd[128];
+
+	constexpr CardTables() : rank(), suit(), clr(), odd() {
+		for (int i = 0; i < 128; ++i) {
+			int value = i & CARD_VALUE;
+			rank[i] = value < 52 ? value % 13 : -1;
+			suit[i] = value < 52 ? value / 13 : -1;
+			clr[i] = value < 52 ? (value / 13) & 1 : 0;
+			odd[i] = value < 52 ? (value % 13) & 1 : 0;
+		}
 	}
-	char Rank() {
-		return (rank >= 0 ? RANKS[rank] : 'X');
+};
+
+constexpr CardTables CARD = CardTables();
+
+//bit masks over card values for Solitaire::deadEnd: the lower cards of the same suit as each card
+//and the two cards it can be moved onto in the tableau, none for kings
+struct BlockTables {
+	unsigned long long lower[52], parents[52];
+
+	constexpr BlockTables() : lower(), parents() {
+		for (int i = 0; i < 52; ++i) {
+			int suit = i / 13, rank = i % 13;
+
+			for (int r = 0; r < rank; ++r) {
+				lower[i] |= 1ULL << (suit * 13 + r);
+			}
+
+			for (int s = 0; s < 4 && rank < 12; ++s) {
+				if ((s & 1) != (suit & 1)) {
+					parents[i] |= 1ULL << (s * 13 + rank + 1);
+				}
+			}
+		}
 	}
-	char Suit() {
-		return (suit >= 0 ? SUITS[suit] : 'X');
+};
+
+constexpr BlockTables BLOCK = BlockTables();
+
+//card values with the two black suits (bit 0 of the swap) and/or the two red suits (bit 1) traded, for Solitaire::key
+struct SwapTables {
+	unsigned char value[4][64];
+
+	constexpr SwapTables() : value() {
+		for (int swap = 0; swap < 4; ++swap) {
+			for (int i = 0; i < 64; ++i) {
+				value[swap][i] = i < 52 && (swap >> (i / 13 & 1)) & 1 ? (i + 26) % 52 : i;
+			}
+		}
 	}
 };
 
+constexpr SwapTables SWAP = SwapTables();
+
+void printCard(Card card) {
+	printf("%c%c%c", (card & CARD_UP ? '+' : '-'), (CARD.rank[card] >= 0 ? RANKS[CARD.rank[card]] : 'X'), (CARD.suit[card] >= 0 ? SUITS[CARD.suit[card]] : 'X'));
+	fflush(stdout);
+}
+
 class Pile {
 	public:
-		Card* cards[24];
-		int size, top;//top represents index of bottom most faceup card. ie) if all cards are faceup it would be 0
+		Card cards[24];
+		signed char size, top;//top represents index of bottom most faceup card. ie) if all cards are faceup it would be 0
 		Pile() {
 			size = 0;
 			top = -1;
 
 			for (int i = 0; i < 24; ++i) {
-				cards[i] = NULL;
+				cards[i] = 0;
 			}
 		}
-		void add(Card* card) {
-			cards[size++] = card;
-			card->up = 0;
+		void add(Card card) {
+			cards[size++] = card & CARD_VALUE;
 		}
 		void flip() {
-			Card* temp = cards[size - 1];
-
-			if ((temp->up = !temp->up)) {
+			if ((cards[size - 1] ^= CARD_UP) & CARD_UP) {
 				top = size - 1;
 				return;
 			}
@@ -289,22 +677,19 @@ class Pile {
 			top = -1;
 		}
 		int highValue() {
-			return size > 0 ? cards[0]->value : -1;
+			return size > 0 ? cards[0] & CARD_VALUE : -1;
 		}
 		bool topIsNotUp() {
-			return size > 0 && !cards[size - 1]->up;
+			return size > 0 && !(cards[size - 1] & CARD_UP);
 		}
-		Card* highCard() {
-			return top >= 0 ? cards[top] : NULL;
-		}
-		Card* cardFrom(int card) {
+		Card cardFrom(int card) {
 			return cards[size - card];
 		}
 		int topRank() {
-			return size > 0 ? cards[size - 1]->rank : -1;
+			return size > 0 ? CARD.rank[cards[size - 1]] : -1;
 		}
 		int highRank() {
-			return top >= 0 ? cards[top]->rank : -1;
+			return top >= 0 ? CARD.rank[cards[top]] : -1;
 		}
 		int faceUpCount() {
 			return top >= 0 ? size - top : 0;
@@ -335,30 +720,39 @@ class Pile {
 				top = -1;
 			}
 		}
-		//used for the talon
+		//used for the talon. moves count cards from this pile to the other one, going around through a redeal
+		//if there are not enough (or thru is set and there are just enough). returns true if it went around.
 		bool removeTop(Pile* to, int count, bool thru) {
-			if (size > count || (size == count && !thru)) {
-				int i = size - count;
+			bool around = size < count || (size == count && thru);
 
-				do {
-					--size;
-					cards[size]->up = !cards[size]->up;
-					to->cards[to->size++] = cards[size];
-				} while (size > i);
+			if (around) {
+				//after the redeal the waste holds count - size cards, take back any more than that
+				count = to->size + size - count;
 
-				return false;
+				if (count > 0) {
+					do {
+						--to->size;
+						--count;
+						to->cards[to->size] ^= CARD_UP;
+						cards[size++] = to->cards[to->size];
+					} while (count > 0);
+
+					return true;
+				}
+
+				//drawing more than one card at a time the redeal can end further on than where it started
+				count = -count;
 			}
 
-			count = to->size + size - count;
+			int i = size - count;
 
 			do {
-				--to->size;
-				--count;
-				to->cards[to->size]->up = !to->cards[to->size]->up;
-				cards[size++] = to->cards[to->size];
-			} while (count > 0);
+				--size;
+				cards[size] ^= CARD_UP;
+				to->cards[to->size++] = cards[size];
+			} while (size > i);
 
-			return true;
+			return around;
 		}
 		void clear() {
 			size = 0;
@@ -366,7 +760,7 @@ class Pile {
 		}
 		void print() const {
 			for (int i = size - 1; i >= 0; --i) {
-				cards[i]->print();
+				printCard(cards[i]);
 			}
 		}
 };
@@ -525,7 +919,8 @@ class MoveList {
 				temp = temp->next;
 			}
 		}
-		void printPretty() {
+		//a move's val is the number of cards turned over from the stock before it, each draw turns over up to drawCount
+		void printPretty(int drawCount = 1) {
 			Move* tmp = first;
 			int ss = 24;
 			int ws = 0;
@@ -533,16 +928,18 @@ class MoveList {
 			while (tmp != NULL) {
 				int val = tmp->val;
 
-				while ((--val) >= 0) {
+				while (val > 0) {
 					if (ss == 0) {
 						printf("[NewRound]");
 						ss = ws;
 						ws = 0;
 					}
 
+					int drawn = ss < drawCount ? ss : drawCount;
 					printf("[Draw]");
-					--ss;
-					++ws;
+					ss -= drawn;
+					ws += drawn;
+					val -= drawn;
 				}
 
 				int f = tmp->from;
@@ -566,7 +963,14 @@ class MoveList {
 			}
 		}
 		//this function is used to integrate into my java gui so I can visualize solutions
-		void printPacked() const {
+		void printPacked(int drawCount = 1) const {
+			char* pack = packed(drawCount);
+			printf("%s", pack);
+			fflush(stdout);
+			delete []pack;
+		}
+		//same as printPacked but returns the string so it can be written out later
+		char* packed(int drawCount = 1) const {
 			Move* tmp = first;
 			int f = 0, t;
 			int ss = 24;
@@ -576,27 +980,32 @@ class MoveList {
 			while (tmp != NULL) {
 				val = tmp->val;
 
-				while ((--val) >= 0) {
+				while (val > 0) {
 					if (ss == 0) {
 						++f;
 						ss = ws;
 						ws = 0;
 					}
 
-					--ss;
-					++ws;
+					int drawn = ss < drawCount ? ss : drawCount;
+					ss -= drawn;
+					ws += drawn;
+					val -= drawn;
+					++f;
 				}
 
 				if (tmp->from == WASTE) {
 					--ws;
 				}
 
-				f += 1 + tmp->val;
+				++f;
 				tmp = tmp->next;
 			}
 
-			printf("%c%c", f / 24 + 0x30, f % 24 + 0x30);
-			fflush(stdout);
+			char* pack = new char[3 + f * 3];
+			char* z = pack;
+			*z++ = f / 24 + 0x30;
+			*z++ = f % 24 + 0x30;
 			tmp = first;
 			ss = 24;
 			ws = 0;
@@ -604,18 +1013,22 @@ class MoveList {
 			while (tmp != NULL) {
 				val = tmp->val;
 
-				while ((--val) >= 0) {
+				while (val > 0) {
 					if (ss == 0) {
-				 		printf("%c%c%c", 0x31, 0x30, ws + 0x30);
-						fflush(stdout);
+						*z++ = 0x31;
+						*z++ = 0x30;
+						*z++ = ws + 0x30;
 						ss = ws;
 						ws = 0;
 					}
 
-					printf("%c%c%c", 0x30, 0x31, 0x31);
-					fflush(stdout);
-					--ss;
-					++ws;
+					int drawn = ss < drawCount ? ss : drawCount;
+					*z++ = 0x30;
+					*z++ = 0x31;
+					*z++ = drawn + 0x30;
+					ss -= drawn;
+					ws += drawn;
+					val -= drawn;
 				}
 
 				f = tmp->from;
@@ -627,10 +1040,14 @@ class MoveList {
 				t = tmp->to;
 				f = (f <= TABLEAU7 && f >= TABLEAU1) ? f + 1 : (f == STOCK ? WASTE : (f == WASTE ? TABLEAU1 : f));
 				t = (t <= TABLEAU7 && t >= TABLEAU1) ? t + 1 : (t == STOCK ? WASTE : (t == WASTE ? TABLEAU1 : t));
-				printf("%c%c%c", f + 0x30, t + 0x30, tmp->cards + 0x30);
-				fflush(stdout);
+				*z++ = f + 0x30;
+				*z++ = t + 0x30;
+				*z++ = tmp->cards + 0x30;
 				tmp = tmp->next;
 			}
+
+			*z = 0;
+			return pack;
 		}
 };
 
@@ -638,117 +1055,198 @@ enum MoveMasks {
 	MOVE_USED = 0x10000000,
 	MOVE_REQ = 0x20000000,
 	MOVE_LAST = 0x40000000,
+	MOVE_HELD = 0x08000000, //held by a search thread, off the list until it is expanded or shared again
 	MOVE_VALUE = 0x00ffffff
 };
 
 class MoveArray {
 	private:
+		//open moves are sorted on val, which is ((52 - foundation count + rounds) << 6) | cards drawn, so a bucket per value
+		//is enough. the few larger values (the root) share the last bucket, which is sorted on its own afterwards.
+		static const int BUCKETS = 8192;
+
 		Move* store, *first, *last;
-		MoveArray* lists;
-		int capacity, open;
+		Move** heads, **tails; //first and last move of each bucket while sorting
+		int capacity, open, high; //high is one past the highest slot ever handed out since the last clear
+		int maxCapacity; //the array is never resized past this, 0 for no limit
 
-		MoveArray() {
-			size = 0;
-			open = 0;
-			top = 0;
-			capacity = 0;
-			first = NULL;
-			last = NULL;
-			store = NULL;
-			lists = NULL;
+		//append a move to the end of a list given by its first and last move
+		static void append(Move** head, Move** tail, Move* move) {
+			move->next = NULL;
+
+			if (*tail != NULL) {
+				(*tail)->next = move;
+			} else {
+				*head = move;
+			}
+
+			*tail = move;
+		}
+		static bool lessVal(const Move* move1, const Move* move2) {
+			return move1->val < move2->val;
 		}
+		//fill the first free slot with a move, the caller links it
+		Move* place(char fromPile, char toPile, char cardsMoved, int val, int pos) {
+			if (size + 1 > capacity) {
+				int length = capacity * 1.5;
+				resize(maxCapacity > 0 && length > maxCapacity ? maxCapacity : length);
+			}
 
-		//used in sorting
-		void addExisting(Move* move) {
 			++size;
+			Move* temp = store + (open++);
 
-			if (last != NULL) {
-				last->next = move;
-				move->next = NULL;
-				last = move;
-				return;
+			if (open > high) {
+				high = open;
 			}
 
-			first = move;
-			move->next = NULL;
-			last = first;
-			return;
+			//fill in gaps, held moves are not on the list but their slots are taken
+			Move* chk = temp + 1;
+			while (open < capacity && (chk->next != NULL || last == chk || (chk->val & MOVE_HELD))) {
+				++open; ++chk;
+			}
+
+			temp->from = fromPile;
+			temp->to = toPile;
+			temp->cards = cardsMoved;
+			temp->val = val;
+			temp->prev = pos < 0 ? NULL : store + pos;
+			return temp;
+		}
+		//sort the count moves of the last bucket on val, keeping moves with the same val in order
+		void sortLast(int count) {
+			Move** moves = new Move*[count];
+			Move* temp = heads[BUCKETS - 1];
+
+			for (int i = 0; i < count; ++i, temp = temp->next) {
+				moves[i] = temp;
+			}
+
+			std::stable_sort(moves, moves + count, lessVal);
+			heads[BUCKETS - 1] = NULL;
+			tails[BUCKETS - 1] = NULL;
+
+			for (int i = 0; i < count; ++i) {
+				append(heads + BUCKETS - 1, tails + BUCKETS - 1, moves[i]);
+			}
+
+			delete []moves;
 		}
 	public:
+		static const char SKIP = -2; //cards of a move made by skip
 		int size, top;
+		int resizes; //times the array has grown
 
-		MoveArray(int length) {
+		MoveArray(int length, int maxLength = 0) {
+			resizes = 0;
 			size = 0;
 			open = 0;
+			high = 0;
 			top = 0;
 			capacity = length;
+			maxCapacity = maxLength;
 			first = NULL;
 			last = NULL;
-			lists = new MoveArray[65536];
+			heads = new Move*[BUCKETS];
+			tails = new Move*[BUCKETS];
 			store = NULL;
 			resize(capacity);
+
+			for (int i = 0; i < BUCKETS; ++i) {
+				heads[i] = NULL;
+				tails[i] = NULL;
+			}
 		}
 		~MoveArray() {
 			delete []store;
+			delete []heads;
+			delete []tails;
 		}
 
 		void clear() {
+			//add() looks at the links and held flag of slots to find free ones so wipe every slot we have used
+			for (int i = 0; i < high; ++i) {
+				store[i].next = NULL;
+				store[i].prev = NULL;
+				store[i].val = 0;
+			}
+
+			high = 0;
 			size = 0;
 			top = 0;
 			open = 0;
+			resizes = 0;
 			first = NULL;
 			last = NULL;
 		}
 		Move* get(int pos) {
 			return store + pos;
 		}
-		//radix sort implementation
-		void sort(bool descending) {
+		//bytes used by the array and the sort buckets
+		long long memory() {
+			return (long long)capacity * sizeof(Move) + 2LL * BUCKETS * sizeof(Move*);
+		}
+		//true if count more moves can be added without going over the maximum capacity
+		bool fits(int count) {
+			return maxCapacity == 0 || size + count <= maxCapacity;
+		}
+		//sort open moves ascending on val keeping moves with the same val in order, used moves go last in list order
+		//since they are never expanded again. only the buckets that were filled are visited.
+		void sort() {
 			if (size < 2) {
 				return;
 			}
 
-			int desc = descending ? 0 : 65535;
+			Move* used = NULL, *usedLast = NULL;
+			int low = BUCKETS, highest = -1, overflow = 0;
+			bool sorted = true; //false once a move went into the last bucket after one with a larger val
 
-			for (MoveArray* ma = lists + 65535; ma >= lists; --ma) {
-				ma->clear();
-			}
+			for (Move* temp = first, *next; temp != NULL; temp = next) {
+				next = temp->next;
+
+				if (temp->val & MOVE_USED) {
+					append(&used, &usedLast, temp);
+					continue;
+				}
 
-			Move* temp, *next;
+				int bucket = temp->val < BUCKETS - 1 ? temp->val : BUCKETS - 1;
+				low = bucket < low ? bucket : low;
+				highest = bucket > highest ? bucket : highest;
+				overflow += bucket == BUCKETS - 1;
+				sorted &= bucket < BUCKETS - 1 || tails[bucket] == NULL || tails[bucket]->val <= temp->val;
+				append(heads + bucket, tails + bucket, temp);
+			}
 
-			for (int i = 0; i < 32; i += 16) {
-				temp = first;
+			if (!sorted) {
+				sortLast(overflow);
+			}
 
-				while (temp != NULL) {
-					int bucket = ((temp->val >> i) & 65535) - desc;
+			first = NULL;
+			last = NULL;
 
-					if (bucket < 0) {
-						bucket = -bucket;
-					}
+			for (int i = low; i <= highest; ++i) {
+				if (heads[i] == NULL) {
+					continue;
+				}
 
-					next = temp->next;
-					lists[bucket].addExisting(temp);
-					temp = next;
+				if (last != NULL) {
+					last->next = heads[i];
+				} else {
+					first = heads[i];
 				}
 
-				first = NULL;
-				last = NULL;
-				size = 0;
-				
-				for (MoveArray* ma = lists + 65535; ma >= lists; --ma) {
-					if (ma->size > 0) {
-						temp = ma->first;
-
-						while (temp != NULL) {
-							next = temp->next;
-							addExisting(temp);
-							temp = next;
-						}
+				last = tails[i];
+				heads[i] = NULL;
+				tails[i] = NULL;
+			}
 
-						ma->first = NULL;
-						ma->last = NULL;
-					}
+			if (used != NULL) {
+				if (last != NULL) {
+					last->next = used;
+				} else {
+					first = used;
 				}
+
+				last = usedLast;
 			}
 		}
 		//Remove any moves not needed. Reopen top level moves.
@@ -812,7 +1310,7 @@ class MoveArray {
 			}
 
 			last = prev;
-			sort(false);
+			sort();
 		}
 		//resize array if we ran out of room
 		void resize(int length) {
@@ -820,6 +1318,7 @@ class MoveArray {
 			Move* newStack = new Move[capacity];
 
 			if (store != NULL) {
+				++resizes;
 				Move* temp = newStack;
 				Move* itr = store;
 				int amt = size;
@@ -846,813 +1345,3963 @@ class MoveArray {
 
 			store = newStack;
 		}
-		int moveFirstToLast() {
-			if (last != first) {
-				last->next = first;
-				first = first->next;
-				last = last->next;
-				last->next = NULL;
+		//write the moves to a checkpoint file with their links as slot numbers, -1 for none
+		bool save(FILE* f) {
+			int header[7] = {size, top, open, high, first != NULL ? (int)(first - store) : -1, last != NULL ? (int)(last - store) : -1, resizes};
+			bool written = fwrite(header, sizeof(header), 1, f) == 1;
+
+			for (int i = 0; i < high && written; ++i) {
+				Move* mv = store + i;
+				int saved[6] = {mv->from, mv->to, mv->cards, mv->val, mv->next != NULL ? (int)(mv->next - store) : -1,
+					mv->prev != NULL ? (int)(mv->prev - store) : -1};
+				written = fwrite(saved, sizeof(saved), 1, f) == 1;
 			}
 
-			last->val |= MOVE_LAST;
-			--top;
-			return (int)(last - store);
+			return written;
 		}
-		void setUsed(int pos) {
-			store[pos].val |= MOVE_USED;
-		}
-		//add move to list and sort first few moves ascending
-		int add(char fromPile, char toPile, char cardsMoved, int val, int pos = -1) {
-			if (size + 1 > capacity) {
-				resize(capacity * 1.5);
-			}
+		//replace the moves with ones written by save, false if the file is cut short or they do not fit the maximum
+		//capacity. the array has to be cleared before it is used after that
+		bool load(FILE* f) {
+			int header[7];
+			clear();
 
-			++top;
-			++size;
-			Move* temp = store + (open++);
+			if (fread(header, sizeof(header), 1, f) != 1 || header[3] < 0 || (maxCapacity > 0 && header[3] > maxCapacity)) {
+				return false;
+			}
 
-			//fill in gaps
-			Move* chk = temp + 1;
-			while (chk->next != NULL || last == chk) {
-				++open; ++chk;
+			if (header[3] > capacity) {
+				resize(header[3]);
 			}
 
-			temp->from = fromPile;
-			temp->to = toPile;
-			temp->cards = cardsMoved;
-			temp->val = val;
-			temp->prev = pos < 0 ? NULL : store + pos;
+			high = header[3];
 
-			if (first != NULL) {
-				temp->next = first;
-				first = temp;
+			for (int i = 0; i < high; ++i) {
+				int saved[6];
+
+				if (fread(saved, sizeof(saved), 1, f) != 1 || saved[4] >= high || saved[5] >= high) {
+					return false;
+				}
 
-				return size - 1;
+				Move* mv = store + i;
+				mv->from = saved[0];
+				mv->to = saved[1];
+				mv->cards = saved[2];
+				mv->val = saved[3];
+				mv->next = saved[4] >= 0 ? store + saved[4] : NULL;
+				mv->prev = saved[5] >= 0 ? store + saved[5] : NULL;
 			}
 
-			temp->next = NULL;
-			first = temp;
-			last = first;
-			return size - 1;
-		}
-};
+			if (header[4] >= high || header[5] >= high) {
+				return false;
+			}
 
-class Solitaire {
-	private:
-		int order[7]; //used for pile sorting
-		Random random;
-		Card cards[52];
-		Pile piles[13];
-		MoveList moves; //list of moves currently available in the current state
-		int redMin, blackMin; //minimum rank in foundation for red/black
-		int rounds; //times through deck/talon
-		int foundationCount; //cards in foundation
-		int drawCount;
+			size = header[0];
+			top = header[1];
+			open = header[2];
+			first = header[4] >= 0 ? store + header[4] : NULL;
+			last = header[5] >= 0 ? store + header[5] : NULL;
+			resizes = header[6];
+			return true;
+		}
+		//take the first open move off the list for a search thread to hold, returns its slot
+		int holdFirst() {
+			Move* temp = first;
+			first = first->next;
+			last = first != NULL ? last : NULL;
+			temp->next = NULL;
+			temp->val |= MOVE_HELD;
+			--top;
+			return (int)(temp - store);
+		}
+		//put a held move on the end of the list once it is expanded
+		void heldToLast(int pos) {
+			Move* temp = store + pos;
+			temp->val = (temp->val & ~MOVE_HELD) | MOVE_LAST;
+			temp->next = NULL;
+
+			if (last != NULL) {
+				last->next = temp;
+			} else {
+				first = temp;
+			}
+
+			last = temp;
+		}
+		//give a held move back to the front of the list for any thread to expand
+		void heldToFirst(int pos) {
+			Move* temp = store + pos;
+			temp->val &= ~MOVE_HELD;
+			temp->next = first;
+			first = temp;
+			last = last != NULL ? last : temp;
+			++top;
+		}
+		void setUsed(int pos) {
+			store[pos].val |= MOVE_USED;
+		}
+		//true until the move is expanded, held moves are still open
+		bool isOpen(int pos) {
+			return (store[pos].val & MOVE_LAST) == 0;
+		}
+		//true if node is pos or on the path from the root to it
+		bool isAncestor(int pos, int node) {
+			for (Move* temp = store + pos; temp != NULL; temp = temp->prev) {
+				if (temp == store + node) {
+					return true;
+				}
+			}
+
+			return false;
+		}
+		//turn an expanded move into a link to the move at to, which reaches the same position by a shorter path.
+		//it is never expanded again and the moves after it follow the shorter path, paths leave it out
+		void skip(int pos, int to) {
+			Move* temp = store + pos;
+			temp->from = -1;
+			temp->to = -1;
+			temp->cards = SKIP;
+			temp->val |= MOVE_USED;
+			temp->prev = store + to;
+		}
+		//add move to list and sort first few moves ascending, returns its slot
+		int add(char fromPile, char toPile, char cardsMoved, int val, int pos = -1) {
+			++top;
+			Move* temp = place(fromPile, toPile, cardsMoved, val, pos);
+
+			if (first != NULL) {
+				temp->next = first;
+				first = temp;
+
+				return (int)(temp - store);
+			}
+
+			temp->next = NULL;
+			first = temp;
+			last = first;
+			return (int)(temp - store);
+		}
+		//add a move for the search thread that made it to hold, returns its slot
+		int addHeld(char fromPile, char toPile, char cardsMoved, int val, int pos) {
+			Move* temp = place(fromPile, toPile, cardsMoved, val | MOVE_HELD, pos);
+			temp->next = NULL;
+			return (int)(temp - store);
+		}
+};
+
+//microseconds from a monotonic clock, used to time the parts of a search
+long long microTime() {
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+}
+
+//counts for one depth bound of a search
+struct IterationStats {
+	int bound;
+	int openStart, openTop, openEnd; //open list size and open moves after the prune that started the bound, size at the end
+	long long expanded, generated; //nodes expanded and the moves found in them
+	long long seen, added, lowered, dropped; //closed set results for the children within the bound, see ClosedResult
+	long long evicted; //closed set states evicted to make room for new ones
+	long long skipped; //lowered positions whose expanded node was replaced by a new one on the shorter path, see MoveArray::skip
+	long long probes; //closed set slots looked at over all those lookups
+	int maxProbe;
+	long long pruneUs, searchUs;
+};
+
+//statistics filled in by Solitaire::solve
+class SearchStats {
 	public:
-		Solitaire(int drawCount) {
-			random = Random();
-			moves = MoveList();
-			this->drawCount = drawCount;
+		IterationStats* iterations;
+		int count, capacity;
+		long long setupUs, totalUs;
+		int closedSize, closedLevels, openResizes;
+		long long memory; //bytes used by the closed set and open list at the end
+		long long maxRssKb; //peak resident size of the whole process so far
+
+		SearchStats() {
+			capacity = 16;
+			iterations = new IterationStats[capacity];
+			clear();
+		}
+		~SearchStats() {
+			delete []iterations;
+		}
 
-			for (int i = 0; i < 52; ++i) {
-				cards[i].set(i);
+		void clear() {
+			count = 0;
+			setupUs = 0;
+			totalUs = 0;
+			closedSize = 0;
+			closedLevels = 0;
+			openResizes = 0;
+			memory = 0;
+			maxRssKb = 0;
+		}
+		//start counting a new depth bound
+		IterationStats* next(int bound) {
+			if (count == capacity) {
+				IterationStats* larger = new IterationStats[capacity << 1];
+				memcpy(larger, iterations, count * sizeof(IterationStats));
+				delete []iterations;
+				iterations = larger;
+				capacity <<= 1;
 			}
 
-			reset();
+			IterationStats* it = iterations + count++;
+			memset(it, 0, sizeof(IterationStats));
+			it->bound = bound;
+			return it;
+		}
+		//add the counts of another record to this bound
+		static void add(IterationStats* to, const IterationStats* from) {
+			to->expanded += from->expanded;
+			to->generated += from->generated;
+			to->seen += from->seen;
+			to->added += from->added;
+			to->lowered += from->lowered;
+			to->dropped += from->dropped;
+			to->evicted += from->evicted;
+			to->skipped += from->skipped;
+			to->probes += from->probes;
+			to->maxProbe = from->maxProbe > to->maxProbe ? from->maxProbe : to->maxProbe;
+		}
+		//the statistics as a JSON object, the caller deletes the string
+		char* json() const {
+			int length = 512 + count * 512;
+			char* out = new char[length];
+			int n = snprintf(out, length, "{\"setupUs\":%lld,\"totalUs\":%lld,\"closedSize\":%i,\"closedLevels\":%i,\"openResizes\":%i,\"memory\":%lld,\"maxRssKb\":%lld,\"iterations\":[",
+				setupUs, totalUs, closedSize, closedLevels, openResizes, memory, maxRssKb);
+
+			for (int i = 0; i < count; ++i) {
+				const IterationStats* it = iterations + i;
+				n += snprintf(out + n, length - n, "%s{\"bound\":%i,\"openStart\":%i,\"openTop\":%i,\"openEnd\":%i,\"expanded\":%lld,\"generated\":%lld,"
+					"\"seen\":%lld,\"added\":%lld,\"lowered\":%lld,\"dropped\":%lld,\"evicted\":%lld,\"skipped\":%lld,\"probes\":%lld,\"maxProbe\":%i,\"pruneUs\":%lld,\"searchUs\":%lld}",
+					i > 0 ? "," : "", it->bound, it->openStart, it->openTop, it->openEnd, it->expanded, it->generated,
+					it->seen, it->added, it->lowered, it->dropped, it->evicted, it->skipped, it->probes, it->maxProbe, it->pruneUs, it->searchUs);
+			}
+
+			snprintf(out + n, length - n, "]}");
+			return out;
 		}
+};
 
-		//put the game back to its initial state
-		void reset() {
-			redMin = -1;
-			blackMin = -1;
-			rounds = 0;
-			foundationCount = 0;
+//why a search ended
+enum SolveStop {
+	STOP_SOLVED = 0,
+	STOP_EXHAUSTED, //no solution within the largest depth bound, or no positions left to expand
+	STOP_MEMORY, //the open list reached its memory limit
+	STOP_NODES,
+	STOP_TIME,
+	STOP_CANCELLED
+};
 
-			for (int i = 0; i < 13; ++i) {
-				piles[i].clear();
+const char* STOP_NAMES[] = {"solved", "exhausted", "memory", "nodes", "time", "cancelled"};
+
+//bounds on a search, each one is off when 0 or NULL
+struct SolveLimits {
+	long long nodes; //positions expanded
+	int ms; //milliseconds from the start of the call, including setting up the tables
+	const std::atomic<bool>* cancel; //checked between expansions, the search stops soon after it is set
+
+	SolveLimits() {
+		nodes = 0;
+		ms = 0;
+		cancel = NULL;
+	}
+};
+
+//where solve keeps a copy of its search so a run that is stopped or killed can be carried on later
+struct Checkpoint {
+	const char* filename;
+	int seconds; //save at least this often while searching as well as when the search is stopped, 0 for only then
+	bool resume; //carry on from the file if it holds a search of the same deal
+
+	Checkpoint() {
+		filename = NULL;
+		seconds = 0;
+		resume = false;
+	}
+};
+
+//start of a checkpoint file, followed by the moves of bestPath, the open list and the closed set
+struct CheckpointHeader {
+	char magic[4];
+	Card cards[52];
+	int drawCount, mm, bestF, pathLength;
+	int suitSwaps; //the closed set keys were made with suits traded
+	long long nodes;
+};
+
+//what the last solve or solveFast got done, filled in however it stopped
+struct SolveResult {
+	SolveStop stop;
+	int moves; //solution length, -1 when there is none
+	int bestF; //most cards in the foundation of any position reached, bestPath in Solitaire leads to it
+	int bound; //no solution is shorter than this, 0 from solveFast
+	long long nodes; //positions expanded
+};
+
+//checks a search against its SolveLimits, the clock is only read every 256 nodes
+class LimitCheck {
+	private:
+		const SolveLimits* limits;
+		long long deadline, nextClock;
+	public:
+		void start(const SolveLimits* limits, long long startUs) {
+			this->limits = limits;
+			deadline = limits != NULL && limits->ms > 0 ? startUs + limits->ms * 1000LL : 0;
+			nextClock = 0;
+		}
+		//the limit reached after nodes expansions, STOP_SOLVED for none
+		SolveStop reached(long long nodes) {
+			if (limits == NULL) {
+				return STOP_SOLVED;
 			}
 
-			for (int j = TABLEAU1, i = 0; j <= TABLEAU7; ++j) {
-				for (int k = j; k <= TABLEAU7; ++k, ++i) {
-					piles[k].add(cards + i);
+			if (limits->cancel != NULL && limits->cancel->load(std::memory_order_relaxed)) {
+				return STOP_CANCELLED;
+			}
+
+			if (limits->nodes > 0 && nodes >= limits->nodes) {
+				return STOP_NODES;
+			}
+
+			if (deadline > 0 && nodes >= nextClock) {
+				nextClock = nodes + 256;
+
+				if (microTime() >= deadline) {
+					return STOP_TIME;
 				}
 			}
 
-			for (int i = 51; i >= 28; --i) {
-				piles[STOCK].add(cards + i);
+			return STOP_SOLVED;
+		}
+		//true if reached would stop the search at a cancel or node limit, threads ask it between expansions without
+		//the search lock so they know to come back for the check
+		bool near(long long nodes) const {
+			return limits != NULL && ((limits->cancel != NULL && limits->cancel->load(std::memory_order_relaxed))
+				|| (limits->nodes > 0 && nodes >= limits->nodes));
+		}
+};
+
+//which talon cards can be played next, for every number of cards left in the talon and in the waste.
+//the talon is read as the waste from the bottom up followed by the stock from the top down. a draw moves the end of the
+//waste drawCount cards along it and a redeal takes it back to the start, so what can be reached only depends on the
+//two sizes. each entry is where the waste can end (1 for the first talon card) and the cards turned over to get there.
+//ends reached without a redeal come first, then the ones that need one, both in talon order.
+class TalonTable {
+	public:
+		struct Entry {
+			unsigned char end, val;
+		};
+	private:
+		static const int SIZES = 25, MAX_ENTRIES = 48;
+		Entry* entries;
+		unsigned char counts[SIZES][SIZES];
+	public:
+		TalonTable(int drawCount) {
+			entries = new Entry[SIZES * SIZES * MAX_ENTRIES];
+
+			for (int talon = 0; talon < SIZES; ++talon) {
+				for (int waste = 0; waste <= talon; ++waste) {
+					Entry* e = entries + (talon * SIZES + waste) * MAX_ENTRIES;
+					bool reached[SIZES] = {false};
+					int count = 0, stock = talon - waste;
+
+					for (int end = waste; end < talon;) {
+						end = end + drawCount < talon ? end + drawCount : talon;
+						reached[end] = true;
+						e[count].end = end;
+						e[count++].val = end - waste;
+					}
+
+					for (int end = 0; end < talon;) {
+						end = end + drawCount < talon ? end + drawCount : talon;
+
+						if (!reached[end] && end != waste) {
+							e[count].end = end;
+							e[count++].val = stock + end;
+						}
+					}
+
+					counts[talon][waste] = count;
+				}
 			}
+		}
+		~TalonTable() {
+			delete []entries;
+		}
 
-			for (int i = TABLEAU1; i <= TABLEAU7; ++i) {
-				piles[i].flip();
+		//the entries for a talon and waste size, count is set to how many there are
+		const Entry* get(int talon, int waste, int* count) const {
+			*count = counts[talon][waste];
+			return entries + (talon * SIZES + waste) * MAX_ENTRIES;
+		}
+};
+
+const int DOWN_CARDS = 21; //face down cards in a deal, tableau piles 2 to 7 hold 1 to 6 of them
+const int DOWN_STATES = 5040; //ways to have turned part of them over, 1 * 2 * ... * 7
+const short DOWN_RADIX[8] = {0, 1, 1, 2, 6, 24, 120, 720}; //weight of each tableau pile's face down count in a state
+
+//a deal's face down cards and the table for them, see PatternFile
+struct PatternEntry {
+	Card down[DOWN_CARDS]; //tableau piles 2 to 7 from the bottom up
+	unsigned char bonus[DOWN_STATES]; //by state, the sum of the face down counts times DOWN_RADIX
+};
+
+struct PatternHeader {
+	char magic[4];
+	int count;
+};
+
+//pattern database for minWinAt made by KlondikeSolver --make-patterns and mapped read only, so every process
+//solving from the same file shares one copy. face down cards are only ever taken off the top of what is left of
+//a pile's deal, so how many are left in each pile picks out all of them and the deal has 5040 such states.
+//a face down card has to leave its pile once, and unless every lower card of its suit has already left theirs
+//that move can not be to the foundation. minWinAt only counts the lower cards under it in its own pile, the table
+//holds how many more moves the best order of taking them off every pile needs, so adding it keeps the bound admissible.
+class PatternFile {
+	private:
+		const PatternEntry* entries; //sorted by down
+		int count;
+		void* map;
+		size_t mapSize;
+
+		static int compare(const void* a, const void* b) {
+			return memcmp(((const PatternEntry*)a)->down, ((const PatternEntry*)b)->down, DOWN_CARDS);
+		}
+	public:
+		//tables already in memory, sorted by down
+		PatternFile(const PatternEntry* entries = NULL, int count = 0) {
+			this->entries = entries;
+			this->count = count;
+			map = NULL;
+			mapSize = 0;
+		}
+		~PatternFile() {
+			if (map != NULL) {
+				munmap(map, mapSize);
 			}
 		}
-		//generate an array of characters that represent the state of the game
-		char* key() {
-			order[0] = TABLEAU1;
-			order[1] = TABLEAU2;
-			order[2] = TABLEAU3;
-			order[3] = TABLEAU4;
-			order[4] = TABLEAU5;
-			order[5] = TABLEAU6;
-			order[6] = TABLEAU7;
-			int cur = 1;
-			int fuc = piles[cur].size;
-			//sort the piles
-			while (cur < 7) {
-				int curT = cur;
 
-				do {
-					if (piles[order[curT - 1]].highValue() <= piles[order[curT]].highValue()) {
+		//map a file written by write, false if it can not be read or is not one
+		bool open(const char* filename) {
+			int fd = ::open(filename, O_RDONLY);
+			struct stat st;
+
+			if (fd < 0 || fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(PatternHeader)) {
+				if (fd >= 0) {
+					close(fd);
+				}
+
+				return false;
+			}
+
+			void* data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+			close(fd);
+
+			if (data == MAP_FAILED) {
+				return false;
+			}
+
+			const PatternHeader* header = (const PatternHeader*)data;
+
+			if (memcmp(header->magic, "KPDB", 4) != 0 || header->count < 0
+					|| (size_t)st.st_size != sizeof(PatternHeader) + (size_t)header->count * sizeof(PatternEntry)) {
+				munmap(data, st.st_size);
+				return false;
+			}
+
+			map = data;
+			mapSize = st.st_size;
+			entries = (const PatternEntry*)(header + 1);
+			count = header->count;
+			return true;
+		}
+		//the table for a deal's face down cards, NULL if it is not in the file
+		const unsigned char* find(const Card* down) const {
+			int low = 0, high = count - 1;
+
+			while (low <= high) {
+				int mid = (low + high) >> 1;
+				int cmp = memcmp(entries[mid].down, down, DOWN_CARDS);
+
+				if (cmp == 0) {
+					return entries[mid].bonus;
+				} else if (cmp < 0) {
+					low = mid + 1;
+				} else {
+					high = mid - 1;
+				}
+			}
+
+			return NULL;
+		}
+
+		//fill in the table for the face down cards of an entry. the fewest moves off the piles for a state is the
+		//best of taking the top face down card off any pile, which costs a move when a lower card of its suit is
+		//still face down anywhere, and then doing the best for the state left
+		static void build(PatternEntry* entry) {
+			Card down[8][6];
+			bool under[8][6]; //a lower card of its suit is under it in its own pile
+			signed char first[8][6][8]; //for each card, the lowest place in each pile holding a lower card of its suit
+			unsigned char moves[DOWN_STATES], counted[DOWN_STATES];
+
+			for (int i = TABLEAU2, n = 0; i <= TABLEAU7; ++i) {
+				for (int j = 0; j < i - TABLEAU1; ++j) {
+					down[i][j] = entry->down[n++];
+				}
+			}
+
+			for (int i = TABLEAU2; i <= TABLEAU7; ++i) {
+				for (int j = 0; j < i - TABLEAU1; ++j) {
+					Card card = down[i][j];
+					memset(first[i][j], 6, sizeof(first[i][j]));
+
+					for (int k = TABLEAU2; k <= TABLEAU7; ++k) {
+						for (int l = k - TABLEAU1 - 1; l >= 0; --l) {
+							if (CARD.suit[down[k][l]] == CARD.suit[card] && CARD.rank[down[k][l]] < CARD.rank[card]) {
+								first[i][j][k] = l;
+							}
+						}
+					}
+
+					under[i][j] = first[i][j][i] < j;
+				}
+			}
+
+			moves[0] = 0;
+			counted[0] = 0;
+
+			for (int state = 1; state < DOWN_STATES; ++state) {
+				int left[8] = {0};
+				int best = 255;
+
+				for (int i = TABLEAU7, rest = state; i >= TABLEAU2; --i) {
+					left[i] = rest / DOWN_RADIX[i];
+					rest %= DOWN_RADIX[i];
+				}
+
+				for (int i = TABLEAU2; i <= TABLEAU7; ++i) {
+					if (left[i] == 0) {
+						continue;
+					}
+
+					int j = left[i] - 1, from = state - DOWN_RADIX[i];
+					int cost = moves[from];
+
+					for (int k = TABLEAU2; k <= TABLEAU7; ++k) {
+						if (first[i][j][k] < left[k]) {
+							++cost;
+							break;
+						}
+					}
+
+					if (cost < best) {
+						best = cost;
+					}
+
+					//what minWinAt counts does not depend on the order, any pile will do
+					counted[state] = counted[from] + under[i][j];
+				}
+
+				moves[state] = best;
+			}
+
+			for (int state = 0; state < DOWN_STATES; ++state) {
+				entry->bonus[state] = moves[state] - counted[state];
+			}
+		}
+		//sort the entries and write them to a file open can map, false if it can not be written
+		static bool write(const char* filename, PatternEntry* entries, int count) {
+			qsort(entries, count, sizeof(PatternEntry), compare);
+			int unique = 0;
+
+			for (int i = 0; i < count; ++i) {
+				if (unique == 0 || compare(entries + unique - 1, entries + i) != 0) {
+					entries[unique++] = entries[i];
+				}
+			}
+
+			FILE* f = fopen(filename, "wb");
+
+			if (f == NULL) {
+				return false;
+			}
+
+			PatternHeader header;
+			memcpy(header.magic, "KPDB", 4);
+			header.count = unique;
+			bool written = fwrite(&header, sizeof(header), 1, f) == 1
+				&& fwrite(entries, sizeof(PatternEntry), unique, f) == (size_t)unique;
+			return fclose(f) == 0 && written;
+		}
+};
+
+//everything that changes while a game is played, kept in one block so it can be saved and restored with a memcpy
+struct Position {
+	Pile piles[13];
+	unsigned long long hash; //hash of the state described by key, kept up to date by makeMove and undoMove
+	int redMin, blackMin; //minimum rank in foundation for red/black
+	int rounds; //times through deck/talon
+	int foundationCount; //cards in foundation
+	short pileWins[8]; //the part of minWinAt for the waste and each tableau pile, see pileWin
+	int winSum; //sum of pileWins
+	short downWins[8]; //the part of pileWins for the face down cards of each tableau pile
+	signed char downLow[8][4]; //lowest rank of each suit among the face down cards of each tableau pile, 13 for none
+	short downState; //face down cards left in each tableau pile as an index into the deal's pattern table
+	signed char hidden[2]; //black and red cards face down, in the stock or in the waste
+};
+
+class Solitaire : private Position {
+	private:
+		int order[7]; //used for pile sorting
+		Random random;
+		Card cards[52]; //the deal, face down
+		MoveList moves; //list of moves currently available in the current state
+		int drawCount; //cards turned over from the stock at a time
+		TalonTable* talon;
+		const PatternFile* patterns; //pattern tables to look deals up in, NULL for none
+		const unsigned char* downBonus; //pattern table of the deal, NULL if there is none
+		bool suitSwaps; //key trades the suits of a colour once all its cards are in view
+		ClosedSet* closed; //closed set and open list are kept between calls to solve so a batch of deals does not reallocate them
+		MoveArray* open;
+		int memLimit; //megabytes closed and open were sized for, 0 for no limit
+		Solitaire** helpers; //games used by the extra threads of a multi-threaded solve
+		int helperCount;
+		bool proofCut; //the last depth first search left out a path for being too long
+
+		//nodes a search thread expands on its own before it merges their children into the open list, and the most
+		//nodes it takes off the shared list at once when it has none left
+		static const int MERGE_EVERY = 16, PULL_BATCH = 4;
+
+		//state shared by every thread searching the same deal. everything but the closed set and waiting is guarded by lock
+		struct Search {
+			ClosedSet* closed;
+			MoveArray* open;
+			MoveList* solution;
+			int mm, bestF, moves; //moves is the solution length once found
+			int busy; //threads holding nodes, the depth bound is only raised once none are
+			int running; //threads expanding nodes outside the lock, the closed set is only evicted once none are
+			std::atomic<int> waiting; //threads with no nodes waiting for the shared list to get some
+			bool show, done;
+			bool saving; //a checkpoint is due, the threads give back the nodes they hold and wait for it to be written
+			bool full; //the open list reached its memory limit and the search was stopped
+			SolveStop stop;
+			long long nodes; //expanded by all threads
+			LimitCheck limits;
+			MoveList* bestPath;
+			SearchStats* stats;
+			IterationStats* current; //counts for the depth bound being searched
+			long long iterationStart;
+			const Checkpoint* checkpoint; //NULL for none
+			long long nextSave; //when the next checkpoint is due, in microTime
+			pthread_mutex_t lock;
+			pthread_cond_t wake;
+		};
+		//a move on the path from the root to the node a thread is expanding
+		struct PathStep {
+			int val, moves; //moves is the number of moves from the root including this one
+			char from, to, cards;
+			bool thru;
+		};
+		//the same moves from the root lead to the same position
+		static bool sameStep(const PathStep* step1, const PathStep* step2) {
+			return step1->from == step2->from && step1->to == step2->to && step1->cards == step2->cards && step1->val == step2->val;
+		}
+		//a child found while expanding a node, its move and auto moves are count steps from first in the step buffer
+		struct PendingNode {
+			ClosedSlot* slot;
+			int mvs, val, arranged, first, count;
+			int node; //its open list slot once merged
+		};
+		//a node in the part of the frontier a thread keeps to itself. its count steps follow the first depth steps of
+		//the thread's path, so the thread makes its moves without walking the open list
+		struct HeldNode {
+			int node; //open list slot, -1 until the thread merges the child it was made for
+			int child; //entry in pending until then
+			int depth; //-1 for a node taken off the shared list whose path is not walked yet
+			int first, count;
+		};
+		//a node a thread expanded since it last merged, its children are count entries of pending from first
+		struct ExpandedNode {
+			int node, child; //as in HeldNode
+			int first, count;
+			bool used; //every move was within the bound
+		};
+		//what one search thread holds and has done since it last merged with the open list. held nodes are a stack with
+		//their steps on a stack of their own, the top one is expanded next so the thread goes depth first on its own
+		struct Frontier {
+			HeldNode* held;
+			PathStep* heldSteps;
+			ExpandedNode* expanded;
+			PendingNode* pending;
+			PathStep* steps;
+			int heldCount, heldStepCount, expandedCount, pendingCount, stepCount;
+			int heldSize, heldStepSize, expandedSize, pendingSize, stepSize;
+			int merged; //held nodes below this have their open list slot
+			IterationStats counts; //for the nodes expanded since the last merge
+
+			Frontier() {
+				heldSize = 64;
+				heldStepSize = MAX_PATH;
+				expandedSize = MERGE_EVERY;
+				pendingSize = 256;
+				stepSize = MAX_PATH;
+				held = new HeldNode[heldSize];
+				heldSteps = new PathStep[heldStepSize];
+				expanded = new ExpandedNode[expandedSize];
+				pending = new PendingNode[pendingSize];
+				steps = new PathStep[stepSize];
+				heldCount = 0;
+				heldStepCount = 0;
+				expandedCount = 0;
+				pendingCount = 0;
+				stepCount = 0;
+				merged = 0;
+				memset(&counts, 0, sizeof(counts));
+			}
+			~Frontier() {
+				delete []held;
+				delete []heldSteps;
+				delete []expanded;
+				delete []pending;
+				delete []steps;
+			}
+		};
+		//make room for count more entries after the size used of an array, growing it to at least twice its length
+		template <class T> static void reserve(T** array, int* length, int size, int count) {
+			if (size + count <= *length) {
+				return;
+			}
+
+			int grown = *length * 2 > size + count ? *length * 2 : size + count;
+			T* temp = new T[grown];
+			memcpy(temp, *array, size * sizeof(T));
+			delete [](*array);
+			*array = temp;
+			*length = grown;
+		}
+		struct SearchArg {
+			Solitaire* game;
+			Search* search;
+		};
+
+		//play the cards that can safely go to the foundation and turn up face down tableau cards until there are none left.
+		//the moves are added to the front of made so it can be walked from first to last to undo them, returns how many
+		int makeAutoMoves(MoveList* made) {
+			int count = 0;
+			bool easy = true;
+			while (easy) {
+				easy = false;
+
+				Pile* pile = piles + WASTE;
+				int wasteSize = pile->size;
+				if (wasteSize > 0 && drawCount == 1) {
+					Card card = pile->cards[wasteSize - 1];
+					int wasteFoundation = 9 + CARD.suit[card];
+
+					if (CARD.rank[card] - piles[wasteFoundation].topRank() == 1) {
+						int min = (CARD.clr[card] == 0 ? redMin : blackMin) + 2;
+
+						if (CARD.rank[card] <= min) {
+							++count;
+							makeMove(WASTE, wasteFoundation, 1, 0);
+							made->addFirst(WASTE, wasteFoundation, 1, 0);
+							easy = true;
+						}
+					}
+				}
+
+				pile = piles + TABLEAU1;
+				for (int i = TABLEAU1; i <= TABLEAU7; ++i, ++pile) {
+					int pile1Size = pile->size;
+
+					if (pile1Size == 0) {
+						continue;
+					}
+
+					Card card = pile->cards[pile1Size - 1];
+
+					if (!(card & CARD_UP)) {
+						++count;
+						makeMove(i, i, 0, 0);
+						made->addFirst(i, i, 0, 0);
+						easy = true;
 						break;
 					}
 
-					int temp = order[curT - 1];
-					order[curT - 1] = order[curT];
-					order[curT--] = temp;
-				} while (curT > 0);
+					int cardFoundation = 9 + CARD.suit[card];
+
+					if (CARD.rank[card] - piles[cardFoundation].topRank() == 1) {
+						int min = (CARD.clr[card] == 0 ? redMin : blackMin) + 2;
+
+						if (CARD.rank[card] <= min) {
+							++count;
+							makeMove(i, cardFoundation, 1, 0);
+							made->addFirst(i, cardFoundation, 1, 0);
+							easy = true;
+							break;
+						}
+					}
+				}
+			}
+
+			return count;
+		}
+		//take back the moves made by makeAutoMoves
+		void undoAutoMoves(MoveList* made) {
+			Move* mv = made->first;
+
+			while (mv != NULL) {
+				undoMove(mv->from, mv->to, mv->cards, 0, false);
+				mv = mv->next;
+			}
+		}
+
+		//size the closed set and open list for a memory limit in megabytes, reusing them when the limit has not changed
+		void prepare(int memory) {
+			if (closed != NULL && memory != memLimit) {
+				delete closed;
+				delete open;
+				closed = NULL;
+				open = NULL;
+			}
+
+			if (closed == NULL) {
+				int shift = 20, length = 1 << 23, maxLength = 0;
+				long long half = (long long)memory << 19;
+				memLimit = memory;
+
+				if (memory > 0) {
+					while (shift > 10 && ((long long)sizeof(ClosedSlot) << shift) > half) {
+						--shift;
+					}
+
+					maxLength = (int)(half / sizeof(Move));
+					length = length < maxLength ? length : maxLength;
+				}
+
+				closed = new ClosedSet(shift, half);
+				open = new MoveArray(length, maxLength);
+			} else {
+				closed->clear();
+				open->clear();
+			}
+		}
+
+		//state of a solveFast search
+		struct Fast {
+			PathStep* path; //every move from the root including the automatic ones
+			int length, moves, bestF; //moves is the solution length once found
+			SolveStop stop; //STOP_EXHAUSTED until a solution or a limit ends the search
+			bool cut; //a child was left out for making the path too long, so running out of positions proves nothing
+			bool prove; //only whether there is a solution matters, see prove
+			LimitCheck limits;
+			IterationStats* counts;
+		};
+		//a move out of a node of the fast search, score is the moves it uses plus twice minWinAt after it,
+		//or just minWinAt when proving
+		struct FastChild {
+			char from, to, cards;
+			int val, score;
+		};
+
+		//whether a tableau card can never move again: a lower card of its suit is under it, so it cannot go to the
+		//foundation, and both cards it could go onto are under it as well. kings are left out since they can move
+		//to an empty pile. only face down cards and the lowest face up card are looked at, the cards above that
+		//are part of a run that can move off the pile with it
+		bool deadEnd() {
+			Pile* pile = piles + TABLEAU1;
+
+			for (int i = TABLEAU1; i <= TABLEAU7; ++i, ++pile) {
+				unsigned long long under = 0;
+
+				for (int j = 0, top = pile->top < 0 ? pile->size - 1 : pile->top; j <= top; ++j) {
+					int card = pile->cards[j] & CARD_VALUE;
+					unsigned long long parents = BLOCK.parents[card];
+
+					if ((under & BLOCK.lower[card]) != 0 && parents != 0 && (under & parents) == parents) {
+						return true;
+					}
+
+					under |= 1ULL << card;
+				}
+			}
+
+			return false;
+		}
+		//add a move and the automatic moves that followed it to the path of a depth first search
+		void pushPath(Fast* fs, FastChild* child, MoveList* made) {
+			PathStep* step = fs->path + fs->length++;
+			step->from = child->from;
+			step->to = child->to;
+			step->cards = child->cards;
+			step->val = child->val;
+
+			for (Move* mv = made->last; mv != NULL; mv = mv->prev) {
+				step = fs->path + fs->length++;
+				step->from = mv->from;
+				step->to = mv->to;
+				step->cards = mv->cards;
+				step->val = 0;
+			}
+		}
+		//depth first search trying the children with the lowest score first, wa is the number of moves made so far.
+		//when proving the closed set is given 0 for every position so it never matters how a position was reached
+		bool fastSearch(Fast* fs, int wa) {
+			if (foundationCount > fs->bestF) {
+				fs->bestF = foundationCount;
+				bestPath.clear();
+
+				for (int i = 0; i < fs->length; ++i) {
+					bestPath.addLast(fs->path[i].from, fs->path[i].to, fs->path[i].cards, fs->path[i].val);
+				}
+			}
+
+			if (foundationCount == 52) {
+				fs->moves = wa;
+				fs->stop = STOP_SOLVED;
+				return true;
+			}
+
+			IterationStats* counts = fs->counts;
+			SolveStop reached = fs->limits.reached(counts->expanded);
+
+			if (reached != STOP_SOLVED) {
+				fs->stop = reached;
+				return false;
+			}
+
+			updateMoves(&moves);
+			++counts->expanded;
+			counts->generated += moves.size;
+
+			if (moves.size == 0) {
+				return false;
+			}
+
+			FastChild* children = new FastChild[moves.size];
+			MoveList made = MoveList();
+			int count = 0, probes;
+
+			//score every child that reaches a position not seen before, keeping them sorted
+			for (Move* mv = moves.first; mv != NULL; mv = mv->next) {
+				made.clear();
+				int cost = drawCost(mv->val) + 1;
+				bool thru = makeMove(mv->from, mv->to, mv->cards, mv->val);
+				cost += makeAutoMoves(&made);
+				int result = closed->addLower(this, closedHash(), fs->prove ? 0 : wa + cost, &probes);
+				counts->probes += probes;
+				counts->maxProbe = probes > counts->maxProbe ? probes : counts->maxProbe;
+				counts->seen += result == CLOSED_SEEN;
+				counts->added += result == CLOSED_ADDED;
+				counts->lowered += result == CLOSED_LOWERED;
+				counts->dropped += result == CLOSED_DROPPED;
+
+				if (closed->needsEviction()) {
+					counts->evicted += closed->evict();
+				}
+
+				//a position reached again by a shorter path is not searched twice and a dead end is not searched at all
+				bool fresh = result == CLOSED_ADDED || result == CLOSED_DROPPED;
+
+				if (fresh && fs->length + made.size >= MAX_PATH) {
+					fs->cut = true;
+				} else if (fresh && !deadEnd()) {
+					int score = fs->prove ? minWinAt() : cost + 2 * minWinAt(), j = count++;
+
+					while (j > 0 && children[j - 1].score > score) {
+						children[j] = children[j - 1];
+						--j;
+					}
+
+					children[j].from = mv->from;
+					children[j].to = mv->to;
+					children[j].cards = mv->cards;
+					children[j].val = mv->val;
+					children[j].score = score;
+				}
+
+				undoAutoMoves(&made);
+				undoMove(mv->from, mv->to, mv->cards, mv->val, thru);
+			}
+
+			bool won = false;
+
+			for (int i = 0; i < count && !won && fs->stop == STOP_EXHAUSTED; ++i) {
+				FastChild* child = children + i;
+				int start = fs->length;
+				made.clear();
+				int cost = drawCost(child->val) + 1;
+				bool thru = makeMove(child->from, child->to, child->cards, child->val);
+				cost += makeAutoMoves(&made);
+				pushPath(fs, child, &made);
+				won = fastSearch(fs, wa + cost);
+
+				if (!won) {
+					undoAutoMoves(&made);
+					undoMove(child->from, child->to, child->cards, child->val, thru);
+					fs->length = start;
+				}
+			}
+
+			delete []children;
+			return won;
+		}
+		//set up and run fastSearch for solveFast or prove and fill in the results like solve does
+		int depthFirst(int* max, bool show, int memory, const SolveLimits* limits, bool prove) {
+			long long start = microTime();
+			stats.clear();
+			prepare(memory);
+			solution.clear();
+			bestPath.clear();
+			reset();
+			closed->addLower(this, closedHash(), 0);
+
+			Fast fs;
+			fs.path = new PathStep[MAX_PATH];
+			fs.length = 0;
+			fs.moves = -1;
+			fs.bestF = 0;
+			fs.stop = STOP_EXHAUSTED;
+			fs.cut = false;
+			fs.prove = prove;
+			fs.limits.start(limits, start);
+			fs.counts = stats.next(0);
+			long long searchStart = microTime();
+			stats.setupUs = searchStart - start;
+
+			//a dead end at the start already settles it
+			bool won = !deadEnd() && fastSearch(&fs, 0);
+
+			if (won) {
+				for (int i = 0; i < fs.length; ++i) {
+					solution.addLast(fs.path[i].from, fs.path[i].to, fs.path[i].cards, fs.path[i].val);
+				}
+			}
+
+			delete []fs.path;
+			proofCut = fs.cut;
+			memoryFull = false; //a full closed set evicts states instead of stopping the search
+			result.stop = fs.stop;
+			result.moves = fs.moves;
+			result.bestF = fs.bestF;
+			result.bound = 0;
+			result.nodes = fs.counts->expanded;
+			long long end = microTime();
+			fs.counts->bound = fs.moves > 0 ? fs.moves : 0;
+			fs.counts->searchUs = end - searchStart;
+			stats.totalUs = end - start;
+			stats.closedSize = closed->size();
+			stats.closedLevels = closed->levelsUsed();
+			stats.memory = closed->memory() + open->memory();
+			rusage usage;
+			getrusage(RUSAGE_SELF, &usage);
+			stats.maxRssKb = usage.ru_maxrss;
+
+			if (fs.moves >= 0) {
+				if (show) {
+					solution.printPacked(drawCount);
+					printf("\n");
+					solution.printPretty(drawCount);
+					printf("\n");
+					fflush(stdout);
+				}
+
+				*max = fs.moves;
+				return 52;
+			}
+
+			*max = 0;
+
+			if (show) {
+				printf("Failed. Nodes: %lld CS: %i F: %i\n", fs.counts->expanded, closed->size(), fs.bestF);
+				showStop();
+			}
+
+			return fs.bestF;
+		}
+
+		static void* searchMain(void* arg) {
+			SearchArg* sa = (SearchArg*)arg;
+			sa->game->search(sa->search);
+			return NULL;
+		}
+		//expand nodes from the shared open list until the deal is solved or the search runs out of depth
+		//write the search to its checkpoint file. it goes to a temporary file first so being killed while
+		//saving leaves the last checkpoint whole
+		bool saveCheckpoint(Search* sh) {
+			char temp[1024];
+			snprintf(temp, sizeof(temp), "%s.tmp", sh->checkpoint->filename);
+			FILE* f = fopen(temp, "wb");
+
+			if (f == NULL) {
+				fprintf(stderr, "Could not write checkpoint %s\n", temp);
+				return false;
+			}
+
+			CheckpointHeader header;
+			memset(&header, 0, sizeof(header));
+			memcpy(header.magic, "KCK2", 4);
+			memcpy(header.cards, cards, sizeof(cards));
+			header.drawCount = drawCount;
+			header.suitSwaps = suitSwaps;
+			header.mm = sh->mm;
+			header.bestF = sh->bestF;
+			header.pathLength = sh->bestPath->size;
+			header.nodes = sh->nodes;
+			bool written = fwrite(&header, sizeof(header), 1, f) == 1;
+
+			for (Move* mv = sh->bestPath->first; mv != NULL && written; mv = mv->next) {
+				int saved[4] = {mv->from, mv->to, mv->cards, mv->val};
+				written = fwrite(saved, sizeof(saved), 1, f) == 1;
+			}
+
+			written = written && sh->open->save(f) && sh->closed->save(f);
+			written = fclose(f) == 0 && written && rename(temp, sh->checkpoint->filename) == 0;
+
+			if (!written) {
+				fprintf(stderr, "Could not write checkpoint %s\n", sh->checkpoint->filename);
+				remove(temp);
+			}
+
+			return written;
+		}
+		//carry on the search in a checkpoint file, false if there is none or it is for another deal, draw count, key
+		//or memory limit. the open list and closed set have to be cleared again when it fails
+		bool loadCheckpoint(Search* sh) {
+			FILE* f = fopen(sh->checkpoint->filename, "rb");
+
+			if (f == NULL) {
+				return false;
+			}
+
+			CheckpointHeader header;
+			bool read = fread(&header, sizeof(header), 1, f) == 1 && memcmp(header.magic, "KCK2", 4) == 0
+				&& memcmp(header.cards, cards, sizeof(cards)) == 0 && header.drawCount == drawCount
+				&& header.suitSwaps == suitSwaps;
+
+			for (int i = 0; read && i < header.pathLength; ++i) {
+				int saved[4];
+				read = fread(saved, sizeof(saved), 1, f) == 1;
+				sh->bestPath->addLast(saved[0], saved[1], saved[2], saved[3]);
+			}
+
+			read = read && sh->open->load(f) && sh->closed->load(f);
+			fclose(f);
+
+			if (read) {
+				sh->mm = header.mm;
+				sh->bestF = header.bestF;
+				sh->nodes = header.nodes;
+			} else {
+				sh->bestPath->clear();
+			}
+
+			return read;
+		}
+		//adds the node of a child a thread found while expanding parent to the open list, for the thread to hold.
+		//called with the search lock held, false if the open list is out of memory
+		bool addChild(Search* sh, int parent, PendingNode* child, PathStep* steps, IterationStats* counts) {
+			MoveArray& open = *sh->open;
+			ClosedSlot* slot = child->slot;
+			//the node the same position got earlier in this bound, its children are moved over to the shorter path.
+			//it can not go under a node that was reached through it
+			int node = slot != NULL ? ClosedSet::node(slot, sh->mm, child->arranged) : -1;
+
+			if (!open.fits(child->count)) {
+				//out of memory for the open list, give up on the deal
+				sh->full = true;
+				sh->stop = STOP_MEMORY;
+				sh->done = true;
+				return false;
+			}
+
+			PathStep* step = &steps[child->first];
+			int at = parent;
+
+			for (int j = 1; j < child->count; ++j, ++step) {
+				at = open.addHeld(step->from, step->to, step->cards, child->val | step->val, at);
+				open.heldToLast(at);
+			}
+
+			//children are expanded before the nodes held under them, so by the time a shorter path turns up the old node
+			//has been expanded. the position is expanded again under the new node and the old one links its children to it
+			child->node = open.addHeld(step->from, step->to, step->cards, child->val | step->val, at);
+
+			if (node >= 0 && !open.isOpen(node) && !open.isAncestor(at, node)) {
+				open.skip(node, child->node);
+				++counts->skipped;
+			}
+
+			if (slot != NULL) {
+				ClosedSet::setNode(slot, child->node, sh->mm, child->arranged);
+			}
+
+			return true;
+		}
+		//add what a thread did since it last merged to the open list, called with the search lock held. every node it
+		//expanded goes on the end of the list in the order it was expanded, followed by the nodes of the children it found
+		//in the order they were found, so the list ends up as if each expansion had been added on its own. false if the
+		//open list ran out of memory
+		bool merge(Search* sh, Frontier* fr) {
+			MoveArray& open = *sh->open;
+
+			for (int i = 0; i < fr->expandedCount; ++i) {
+				ExpandedNode* ex = fr->expanded + i;
+				int parent = ex->node >= 0 ? ex->node : fr->pending[ex->child].node;
+				open.heldToLast(parent);
+
+				//if all branches from this parent have been added mark this move as no longer needed if we reopen the search
+				if (ex->used) {
+					open.setUsed(parent);
+				}
+
+				for (int j = ex->first; j < ex->first + ex->count; ++j) {
+					if (!addChild(sh, parent, fr->pending + j, fr->steps, &fr->counts)) {
+						return false;
+					}
+				}
+			}
+
+			for (int i = fr->merged; i < fr->heldCount; ++i) {
+				HeldNode* h = fr->held + i;
+				h->node = h->node >= 0 ? h->node : fr->pending[h->child].node;
+			}
+
+			fr->merged = fr->heldCount;
+			fr->expandedCount = 0;
+			fr->pendingCount = 0;
+			fr->stepCount = 0;
+			sh->nodes += fr->counts.expanded;
+			SearchStats::add(sh->current, &fr->counts);
+			memset(&fr->counts, 0, sizeof(fr->counts));
+			return true;
+		}
+		//give the count held nodes at the bottom of a thread's stack back to the front of the shared list, called with
+		//the search lock held after a merge. they are the oldest so they have the most left under them
+		void share(Search* sh, Frontier* fr, int count) {
+			for (int i = 0; i < count; ++i) {
+				if (fr->held[i].node >= 0) {
+					sh->open->heldToFirst(fr->held[i].node);
+				}
+			}
+
+			//nodes taken off the shared list and not walked yet are at the bottom with no steps
+			int offset = count == fr->heldCount ? fr->heldStepCount : fr->held[count].depth >= 0 ? fr->held[count].first : 0;
+			fr->heldCount -= count;
+			fr->heldStepCount -= offset;
+			fr->merged = fr->heldCount;
+			memmove(fr->held, fr->held + count, fr->heldCount * sizeof(HeldNode));
+			memmove(fr->heldSteps, fr->heldSteps + offset, fr->heldStepCount * sizeof(PathStep));
+
+			for (int i = 0; i < fr->heldCount; ++i) {
+				fr->held[i].first = fr->held[i].depth >= 0 ? fr->held[i].first - offset : 0;
+			}
+
+			sh->busy -= count > 0 && fr->heldCount == 0;
+		}
+		//hold up to PULL_BATCH nodes from the front of the shared list, the first one goes on top of the stack.
+		//called with the search lock held when the thread holds nothing
+		void pull(Search* sh, Frontier* fr) {
+			MoveArray& open = *sh->open;
+			int count = open.top < PULL_BATCH ? open.top : PULL_BATCH;
+			reserve(&fr->held, &fr->heldSize, 0, count);
+
+			for (int i = count - 1; i >= 0; --i) {
+				HeldNode* h = fr->held + i;
+				h->node = open.holdFirst();
+				h->child = -1;
+				h->depth = -1;
+				h->first = 0;
+				h->count = 0;
+			}
+
+			fr->heldCount = count;
+			fr->heldStepCount = 0;
+			fr->merged = count;
+			++sh->busy;
+		}
+		//fill in the steps of the held node on top of the stack from its moves in the open list, called with the search
+		//lock held. the moves come out backwards, skipped nodes are links to a shorter path and are left out
+		void walk(Search* sh, Frontier* fr) {
+			HeldNode* h = fr->held + fr->heldCount - 1;
+			int length = 0;
+
+			for (Move* temp = sh->open->get(h->node); temp->cards != -1; temp = temp->prev) {
+				length += temp->cards != MoveArray::SKIP;
+			}
+
+			reserve(&fr->heldSteps, &fr->heldStepSize, fr->heldStepCount, length);
+			PathStep* step = fr->heldSteps + fr->heldStepCount + length;
+
+			for (Move* temp = sh->open->get(h->node); temp->cards != -1; temp = temp->prev) {
+				if (temp->cards == MoveArray::SKIP) {
+					continue;
+				}
+
+				--step;
+				step->from = temp->from;
+				step->to = temp->to;
+				step->cards = temp->cards;
+				step->val = temp->val & 63;
+			}
+
+			h->depth = 0;
+			h->first = fr->heldStepCount;
+			h->count = length;
+			fr->heldStepCount += length;
+		}
+		//every thread goes depth first through the nodes it holds and only takes the lock to merge what it found every
+		//MERGE_EVERY nodes. a thread that runs out takes nodes off the front of the shared list, and one that sees
+		//others waiting for nodes gives back the oldest half of its own
+		void search(Search* sh) {
+			ClosedSet& closed = *sh->closed;
+			MoveArray& open = *sh->open;
+			MoveList mList2 = MoveList();
+			//the moves made to reach the last node this thread expanded. the next node shares the path to its parent, so
+			//only the moves after the shared part are undone and made instead of replaying everything from the root
+			PathStep* path = new PathStep[MAX_PATH];
+			Frontier fr = Frontier();
+			int pathLength = 0, mm = 0, bestF = 0;
+			long long nodes = 0; //expanded by all threads when this one last merged
+			int wa, added, probes;
+			bool solved = false;
+			pthread_mutex_lock(&sh->lock);
+
+			while (!sh->done) {
+				//threads still expanding nodes see done when they come back to merge
+				SolveStop reached = sh->limits.reached(sh->nodes);
+
+				if (reached != STOP_SOLVED) {
+					sh->stop = reached;
+					sh->done = true;
+					pthread_cond_broadcast(&sh->wake);
+					break;
+				}
+
+				//states are only evicted from a full closed set while no thread is expanding, see ClosedSet::evict
+				if (closed.needsEviction()) {
+					if (sh->running > 0) {
+						pthread_cond_wait(&sh->wake, &sh->lock);
+						continue;
+					}
+
+					sh->current->evicted += closed.evict();
+					pthread_cond_broadcast(&sh->wake);
+				}
+
+				//the open list and closed set only hold the whole search once every thread gave back what it holds
+				if (sh->nextSave > 0 && !sh->saving && microTime() >= sh->nextSave) {
+					sh->saving = true;
+				}
+
+				if (sh->saving) {
+					share(sh, &fr, fr.heldCount);
+
+					if (sh->busy > 0 || sh->running > 0) {
+						pthread_cond_wait(&sh->wake, &sh->lock);
+						continue;
+					}
+
+					saveCheckpoint(sh);
+					sh->nextSave = microTime() + sh->checkpoint->seconds * 1000000LL;
+					sh->saving = false;
+					pthread_cond_broadcast(&sh->wake);
+				}
+
+				if (sh->waiting > 0 && fr.heldCount > 1) {
+					share(sh, &fr, fr.heldCount / 2);
+					pthread_cond_broadcast(&sh->wake);
+				}
+
+				if (fr.heldCount == 0) {
+					if (open.top == 0) {
+						//other threads can still add nodes at this depth
+						if (sh->busy > 0) {
+							++sh->waiting;
+							pthread_cond_wait(&sh->wake, &sh->lock);
+							--sh->waiting;
+							continue;
+						}
+
+						//reopen the search if we have not found a solution for the next higher depth
+						if (sh->mm >= 256) {
+							sh->done = true;
+							break;
+						}
+
+						++sh->mm;
+						int prevSize = open.size;
+						long long pruneStart = microTime();
+						sh->current->openEnd = prevSize;
+						sh->current->searchUs = pruneStart - sh->iterationStart;
+						open.prune();
+						sh->iterationStart = microTime();
+						sh->current = sh->stats->next(sh->mm);
+						sh->current->openStart = open.size;
+						sh->current->openTop = open.top;
+						sh->current->pruneUs = sh->iterationStart - pruneStart;
+
+						if (sh->show) {
+							printf("Trying: %i OPS: %i OS-OT: %i-%i CS: %i F: %i\n", sh->mm, prevSize, open.size, open.top, closed.size(), sh->bestF);
+							fflush(stdout);
+						}
+
+						if (open.top == 0) {
+							sh->done = true;
+							break;
+						}
+
+						pthread_cond_broadcast(&sh->wake);
+						continue;
+					}
+
+					pull(sh, &fr);
+				}
+
+				if (fr.held[fr.heldCount - 1].depth < 0) {
+					walk(sh, &fr);
+				}
+
+				mm = sh->mm;
+				bestF = sh->bestF;
+				nodes = sh->nodes;
+				++sh->running;
+				pthread_mutex_unlock(&sh->lock);
+
+				do {
+					HeldNode h = fr.held[--fr.heldCount];
+					PathStep* steps = fr.heldSteps + h.first;
+					fr.heldStepCount = h.first;
+					fr.merged = fr.merged < fr.heldCount ? fr.merged : fr.heldCount;
+					int same = h.depth;
+
+					while (same < pathLength && same < h.depth + h.count && sameStep(path + same, steps + same - h.depth)) {
+						++same;
+					}
+
+					//take back the moves that are not shared with the new path
+					if (same == 0) {
+						reset();
+					} else {
+						for (int i = pathLength - 1; i >= same; --i) {
+							PathStep* step = path + i;
+							undoMove(step->from, step->to, step->cards, step->val, step->thru);
+						}
+					}
+
+					//make the rest of the moves
+					for (int i = same; i < h.depth + h.count; ++i) {
+						PathStep* step = path + i;
+						*step = steps[i - h.depth];
+						step->moves = (i > 0 ? path[i - 1].moves : 0) + drawCost(step->val) + 1;
+						step->thru = makeMove(step->from, step->to, step->cards, step->val);
+					}
+
+					pathLength = h.depth + h.count;
+					wa = pathLength > 0 ? path[pathLength - 1].moves : 0;
+
+					//check and see if the game is won
+					if (foundationCount > bestF || (foundationCount == 52 && wa <= mm)) {
+						pthread_mutex_lock(&sh->lock);
+
+						if (foundationCount > sh->bestF) {
+							sh->bestF = foundationCount;
+							sh->bestPath->clear();
+
+							for (int i = 0; i < pathLength; ++i) {
+								sh->bestPath->addLast(path[i].from, path[i].to, path[i].cards, path[i].val);
+							}
+						}
+
+						bestF = sh->bestF;
+
+						if (foundationCount == 52 && wa <= mm) {
+							if (!sh->done) {
+								sh->done = true;
+								sh->stop = STOP_SOLVED;
+								sh->moves = wa;
+
+								for (int i = 0; i < pathLength; ++i) {
+									sh->solution->addLast(path[i].from, path[i].to, path[i].cards, path[i].val);
+								}
+							}
+
+							solved = true;
+							break;
+						}
+
+						pthread_mutex_unlock(&sh->lock);
+					}
+
+					reserve(&fr.expanded, &fr.expandedSize, fr.expandedCount, 1);
+					ExpandedNode* ex = fr.expanded + fr.expandedCount++;
+					ex->node = h.node;
+					ex->child = h.child;
+					ex->first = fr.pendingCount;
+					//update list of available moves
+					updateMoves(&moves);
+					++fr.counts.expanded;
+					fr.counts.generated += moves.size;
+					//check each of the available moves to see if it has been evaluated already or not
+					Move* temp = moves.first;
+					added = 0;
+					int flipped;
+					while (temp != NULL) {
+						mList2.clear();
+						int draws = drawCost(temp->val);
+						bool thru = makeMove(temp->from, temp->to, temp->cards, temp->val);
+						flipped = 1 + makeAutoMoves(&mList2);
+						int mvs = wa + draws + flipped;// + minWinAt();
+
+						//only add moves with length less than current iteration depth
+						if (mvs + minWinAt() <= mm) {
+							++added;
+
+							//only add new moves or moves with fewer total moves
+							ClosedSlot* slot;
+							int result = closed.addLower(this, closedHash(), mvs, &probes, &slot);
+							fr.counts.probes += probes;
+							fr.counts.maxProbe = probes > fr.counts.maxProbe ? probes : fr.counts.maxProbe;
+							fr.counts.seen += result == CLOSED_SEEN;
+							fr.counts.added += result == CLOSED_ADDED;
+							fr.counts.lowered += result == CLOSED_LOWERED;
+							fr.counts.dropped += result == CLOSED_DROPPED;
+
+							if (result != CLOSED_SEEN) {
+								//the children are kept until the thread merges and added to the open list in one locked step
+								reserve(&fr.pending, &fr.pendingSize, fr.pendingCount, 1);
+								reserve(&fr.steps, &fr.stepSize, fr.stepCount, flipped);
+								PendingNode* child = &fr.pending[fr.pendingCount++];
+								child->slot = slot;
+								child->mvs = mvs;
+								child->val = (52 - foundationCount + rounds) << 6;
+								child->arranged = slot != NULL ? arrangement() : 0;
+								child->first = fr.stepCount;
+								child->count = flipped;
+								//the auto moves follow the move, the state is reached after the last of them
+								PathStep* step = &fr.steps[fr.stepCount++];
+								step->from = temp->from;
+								step->to = temp->to;
+								step->cards = temp->cards;
+								step->val = temp->val;
+
+								for (Move* mv = flipped > 1 ? mList2.last : NULL; mv != NULL; mv = mv->prev) {
+									step = &fr.steps[fr.stepCount++];
+									step->from = mv->from;
+									step->to = mv->to;
+									step->cards = mv->cards;
+									step->val = 0;
+								}
+							}
+						}
+
+						undoAutoMoves(&mList2);
+						undoMove(temp->from, temp->to, temp->cards, temp->val, thru);
+						temp = temp->next;
+					}
+
+					//the children go on the stack in the order they were found, so the last one is expanded next
+					int kept = ex->first;
+
+					for (int i = ex->first; i < fr.pendingCount; ++i) {
+						PendingNode* child = fr.pending + i;
+
+						//a later child or another thread has reached the state in fewer moves and adds it itself
+						if (child->slot != NULL && ClosedSet::moves(child->slot) < child->mvs) {
+							continue;
+						}
+
+						fr.pending[kept] = *child;
+						reserve(&fr.held, &fr.heldSize, fr.heldCount, 1);
+						reserve(&fr.heldSteps, &fr.heldStepSize, fr.heldStepCount, child->count);
+						HeldNode* held = fr.held + fr.heldCount++;
+						held->node = -1;
+						held->child = kept++;
+						held->depth = pathLength;
+						held->first = fr.heldStepCount;
+						held->count = child->count;
+						memcpy(fr.heldSteps + held->first, fr.steps + child->first, child->count * sizeof(PathStep));
+						fr.heldStepCount += child->count;
+					}
+
+					fr.pendingCount = kept;
+					ex->count = kept - ex->first;
+					ex->used = added == moves.size;
+				} while (fr.heldCount > 0 && fr.held[fr.heldCount - 1].depth >= 0 && fr.expandedCount < MERGE_EVERY
+					&& (fr.heldCount < 2 || sh->waiting.load(std::memory_order_relaxed) == 0) && !closed.needsEviction()
+					&& !sh->limits.near(nodes + fr.counts.expanded));
+
+				if (solved) {
+					--sh->running;
+					merge(sh, &fr);
+					pthread_cond_broadcast(&sh->wake);
+					break;
+				}
+
+				pthread_mutex_lock(&sh->lock);
+				--sh->running;
+
+				if (merge(sh, &fr)) {
+					sh->busy -= fr.heldCount == 0;
+				}
+
+				if (open.top > 0 || sh->busy == 0 || sh->running == 0) {
+					pthread_cond_broadcast(&sh->wake);
+				}
+			}
+
+			//a search stopped by a limit is saved with the nodes every thread held
+			share(sh, &fr, fr.heldCount);
+			pthread_mutex_unlock(&sh->lock);
+			delete []path;
+		}
+	public:
+		MoveList solution; //moves of the last solution found by solve
+		bool memoryFull; //the open list of the last solve ran into its memory limit
+		SolveResult result; //how the last solve or solveFast ended
+		MoveList bestPath; //moves to the position with the most cards in the foundation the last search reached
+		SearchStats stats; //statistics of the last solve
+
+		Solitaire(int drawCount) {
+			random = Random();
+			moves = MoveList();
+			this->drawCount = drawCount;
+			talon = new TalonTable(drawCount);
+			closed = NULL;
+			open = NULL;
+			memLimit = 0;
+			memoryFull = false;
+			memset(&result, 0, sizeof(result));
+			helpers = NULL;
+			helperCount = 0;
+			proofCut = false;
+			patterns = NULL;
+			downBonus = NULL;
+			suitSwaps = false;
+
+			for (int i = 0; i < 52; ++i) {
+				cards[i] = i;
+			}
+
+			reset();
+		}
+		~Solitaire() {
+			delete talon;
+			delete closed;
+			delete open;
+
+			for (int i = 0; i < helperCount; ++i) {
+				delete helpers[i];
+			}
+
+			delete []helpers;
+		}
+
+		//put the game back to its initial state
+		void reset() {
+			redMin = -1;
+			blackMin = -1;
+			rounds = 0;
+			foundationCount = 0;
+
+			for (int i = 0; i < 13; ++i) {
+				piles[i].clear();
+			}
+
+			for (int j = TABLEAU1, i = 0; j <= TABLEAU7; ++j) {
+				for (int k = j; k <= TABLEAU7; ++k, ++i) {
+					piles[k].add(cards[i]);
+				}
+			}
+
+			for (int i = 51; i >= 28; --i) {
+				piles[STOCK].add(cards[i]);
+			}
+
+			hidden[0] = 26;
+			hidden[1] = 26;
+
+			for (int i = TABLEAU1; i <= TABLEAU7; ++i) {
+				piles[i].flip();
+				--hidden[CARD.clr[piles[i].cards[i - 1]]];
+			}
+
+			rehash();
+			winSum = 0;
+			downState = 0;
+
+			for (int i = WASTE; i <= TABLEAU7; ++i) {
+				if (i != WASTE) {
+					scoreDown(i);
+				}
+
+				pileWins[i] = pileWin(i);
+				winSum += pileWins[i];
+			}
+		}
+		//calculate the hash of the current state from scratch
+		void rehash() {
+			hash = ZOBRIST_SIZE[WASTE][piles[WASTE].size];
+
+			for (int i = FOUNDATION1; i <= FOUNDATION4; ++i) {
+				hash ^= ZOBRIST_SIZE[i][piles[i].size];
+			}
+
+			for (int i = TABLEAU1; i <= TABLEAU7; ++i) {
+				Pile* pile = piles + i;
+
+				for (int j = pile->top >= 0 ? pile->top : pile->size; j < pile->size; ++j) {
+					hash ^= cardHash(pile, j);
+				}
+			}
+		}
+		//hash of a face up tableau card and the card it sits on
+		unsigned long long cardHash(Pile* pile, int i) {
+			return ZOBRIST_CARD[(pile->cards[i] & CARD_VALUE)][i > pile->top ? (pile->cards[i - 1] & CARD_VALUE) : 52];
+		}
+		//update the hash for count cards about to be moved from one pile to another.
+		//only the bottom card moved changes what it sits on, the ones above it keep theirs.
+		void hashMove(int from, int to, int count) {
+			Pile* pile = piles + from;
+			int size = pile->size;
+
+			if (from == WASTE || from >= FOUNDATION1) {
+				hash ^= ZOBRIST_SIZE[from][size] ^ ZOBRIST_SIZE[from][size - count];
+			} else {
+				hash ^= cardHash(pile, size - count);
+			}
+
+			int card = (pile->cards[size - count] & CARD_VALUE);
+			pile = piles + to;
+			size = pile->size;
+
+			if (to == WASTE || to >= FOUNDATION1) {
+				hash ^= ZOBRIST_SIZE[to][size] ^ ZOBRIST_SIZE[to][size + count];
+			} else {
+				hash ^= ZOBRIST_CARD[card][pile->top >= 0 ? (pile->cards[size - 1] & CARD_VALUE) : 52];
+			}
+		}
+		//turning the top card of a tableau pile over adds or removes it from the hash
+		void hashFlip(int pile) {
+			hash ^= ZOBRIST_CARD[piles[pile].cards[piles[pile].size - 1] & CARD_VALUE][52];
+		}
+		//fill comp with KEY_WORDS words that represent the state of the game. when every card of a colour is in view
+		//trading its two suits gives a position of the same deal that plays the same way, so with suitSwaps on the
+		//smallest key of those is used and they share one closed set entry. returns the suits traded for it, see SwapTables
+		int key(unsigned long long* comp) {
+			key(comp, 0);
+			int swaps = suitSwaps ? (hidden[0] == 0) | (hidden[1] == 0) << 1 : 0, best = 0;
+
+			for (int swap = 1; swap <= swaps; ++swap) {
+				if ((swap & swaps) == swap) {
+					unsigned long long other[KEY_WORDS];
+					key(other, swap);
+
+					if (other[2] < comp[2] || (other[2] == comp[2] && (other[1] < comp[1] || (other[1] == comp[1] && other[0] < comp[0])))) {
+						memcpy(comp, other, sizeof(other));
+						best = swap;
+					}
+				}
+			}
+
+			return best;
+		}
+		//which of the positions sharing this one's key it is: the suits key traded and the order it sorted the piles
+		//in, as swap * 5040 plus the rank of the order. positions with the same key and arrangement are the same
+		int arrangement() {
+			unsigned long long comp[KEY_WORDS];
+			int swap = key(comp), rank = 0;
+			key(comp, swap);
+
+			for (int i = 0; i < 7; ++i) {
+				int lower = 0;
+
+				for (int j = i + 1; j < 7; ++j) {
+					lower += order[j] < order[i];
+				}
+
+				rank = rank * (7 - i) + lower;
+			}
+
+			return swap * 5040 + rank;
+		}
+		//hash for the closed set, the kept hash unless key picks between positions with suits traded
+		unsigned long long closedHash() {
+			if (!suitSwaps || (hidden[0] != 0 && hidden[1] != 0)) {
+				return hash;
+			}
+
+			unsigned long long comp[KEY_WORDS];
+			key(comp);
+			unsigned long long h = comp[0] ^ comp[1] * 0x9e3779b97f4a7c15ULL ^ comp[2] * 0xc2b2ae3d27d4eb4fULL;
+			h = (h ^ (h >> 31)) * 0xbf58476d1ce4e5b9ULL;
+			return h ^ (h >> 29);
+		}
+		//the key of the position with the suits of swap traded, see SwapTables
+		void key(unsigned long long* comp, int swap) {
+			const unsigned char* value = SWAP.value[swap];
+			order[0] = TABLEAU1;
+			order[1] = TABLEAU2;
+			order[2] = TABLEAU3;
+			order[3] = TABLEAU4;
+			order[4] = TABLEAU5;
+			order[5] = TABLEAU6;
+			order[6] = TABLEAU7;
+			int cur = 1;
+			//sort the piles
+			while (cur < 7) {
+				int curT = cur;
+
+				do {
+					int high1 = piles[order[curT - 1]].highValue(), high2 = piles[order[curT]].highValue();
+
+					if ((high1 < 0 ? high1 : value[high1]) <= (high2 < 0 ? high2 : value[high2])) {
+						break;
+					}
+
+					int temp = order[curT - 1];
+					order[curT - 1] = order[curT];
+					order[curT--] = temp;
+				} while (curT > 0);
+
+				++cur;
+			}
+
+			int flip = swap & 1 ? 2 : 0;
+			comp[0] = piles[WASTE].size | (piles[FOUNDATION1 + flip].size << 5) | (piles[FOUNDATION2 + (swap & 2)].size << 9)
+				| (piles[FOUNDATION3 - flip].size << 13) | (piles[FOUNDATION4 - (swap & 2)].size << 17);
+			comp[1] = 0;
+			comp[2] = 0;
+			int z = 24, runs = 0;
+			Pile* pile;
+
+			for (int i = 0; i < 7; ++i) {
+				pile = piles + order[i];
+
+				if (pile->top >= 0) {
+					++runs;
+					unsigned long long bits = value[pile->cards[pile->top] & CARD_VALUE] | ((pile->size - pile->top - 1) << 6);
+					int length = 10;
+
+					for (int j = pile->top + 1; j < pile->size; ++j) {
+						bits |= (unsigned long long)(CARD.suit[value[pile->cards[j] & CARD_VALUE]] >> 1) << length++;
+					}
+
+					comp[z >> 6] |= bits << (z & 63);
+
+					if ((z & 63) + length > 64) {
+						comp[(z >> 6) + 1] |= bits >> (64 - (z & 63));
+					}
+
+					z += length;
+				}
+			}
+
+			comp[0] |= runs << 21;
+		}
+		//make a series of moves
+		void makeMove(Move* move) {
+			do {
+				makeMove(move->from, move->to, move->cards, move->val);
+				move = move->next;
+			} while (move != NULL);
+		}
+		//make a single move
+		bool makeMove(int from, int to, int cardsMoved, int val) {
+			bool thru = false;
+
+			if (from != to) {
+				if (val > 0) {
+					hash ^= ZOBRIST_SIZE[WASTE][piles[WASTE].size];
+
+					if (piles[STOCK].removeTop(piles + WASTE, val, false)) {
+						++rounds;
+						thru = true;
+					}
+
+					hash ^= ZOBRIST_SIZE[WASTE][piles[WASTE].size];
+				}
+
+				hashMove(from, to, cardsMoved);
+
+				if (from == WASTE) {
+					--hidden[CARD.clr[piles[WASTE].cards[piles[WASTE].size - 1]]];
+				}
+
+				if (cardsMoved == 1) {
+					piles[from].remove(piles + to);
+
+					if (to >= FOUNDATION1) {
+						++foundationCount;
+						setFoundationMin();
+					} else if (from >= FOUNDATION1) {
+						--foundationCount;
+						setFoundationMin();
+					}
+				} else {
+					piles[from].remove(piles + to, cardsMoved);
+				}
+			} else {
+				hashFlip(from);
+				piles[from].flip();
+				--hidden[CARD.clr[piles[from].cards[piles[from].size - 1]]];
+			}
+
+			rescore(from, to, val);
+			return thru;
+		}
+		//undo a single move. thru is set to true if we made a move that increased the number of rounds.
+		void undoMove(int from, int to, int cardsMoved, int val, bool thru) {
+			if (from != to) {
+				hashMove(to, from, cardsMoved);
+
+				if (cardsMoved == 1) {
+					piles[to].remove(piles + from);
+
+					if (to >= FOUNDATION1) {
+						--foundationCount;
+						setFoundationMin();
+					} else if (from >= FOUNDATION1) {
+						++foundationCount;
+						setFoundationMin();
+					}
+				} else {
+					piles[to].remove(piles + from, cardsMoved);
+				}
+
+				if (from == WASTE) {
+					++hidden[CARD.clr[piles[WASTE].cards[piles[WASTE].size - 1]]];
+				}
+
+				if (val > 0) {
+					hash ^= ZOBRIST_SIZE[WASTE][piles[WASTE].size];
+
+					if (piles[WASTE].removeTop(piles + STOCK, val, thru)) {
+						--rounds;
+					}
+
+					hash ^= ZOBRIST_SIZE[WASTE][piles[WASTE].size];
+				}
+			} else {
+				hashFlip(to);
+				++hidden[CARD.clr[piles[to].cards[piles[to].size - 1]]];
+				piles[to].flip();
+			}
+
+			rescore(from, to, val);
+		}
+		//bring pileWins up to date for the piles a move changed, the face down cards only change when one is turned over
+		void rescore(int from, int to, int val) {
+			if (from == to) {
+				scoreDown(from);
+			}
+
+			if (from <= TABLEAU7) {
+				rescorePile(from);
+			}
+
+			if (to != from && to <= TABLEAU7) {
+				rescorePile(to);
+			}
+
+			if (val > 0 && from != WASTE) {
+				rescorePile(WASTE);
+			}
+		}
+		void rescorePile(int i) {
+			int win = pileWin(i);
+			winSum += win - pileWins[i];
+			pileWins[i] = win;
+		}
+		//add the moves of a single card onto the tableau: every pile it fits on, or the first empty pile for a king
+		void addTableauMoves(MoveList* mvs, int from, Card card, int val, const unsigned char* targets, int firstEmpty) {
+			int fit = targets[card & CARD_VALUE];
+
+			for (int i = TABLEAU1; fit != 0; ++i, fit >>= 1) {
+				if (fit & 1) {
+					mvs->addLast(from, i, 1, val);
+				}
+			}
+
+			if (CARD.rank[card] == 12 && firstEmpty >= 0) {
+				mvs->addLast(from, firstEmpty, 1, val);
+			}
+		}
+		//determine available moves.
+		//cards are looked up in 52 bit masks of the next card each foundation needs and the cards that fit on a tableau pile
+		//so most cards in the talon are skipped with one test. moves come out in the same order as the pile by pile scan
+		//in updateMovesScalar.
+		void updateMoves(MoveList* mvs) {
+			mvs->clear();
+			//Check flip of tableau pile
+			Pile* pile1 = piles + TABLEAU1;
+			Card card1;
+
+			for (int i = TABLEAU1; i <= TABLEAU7; ++i, ++pile1) {
+				int pile1Size = pile1->size;
+
+				if (pile1Size == 0) {
+					continue;
+				}
+
+				if (!(pile1->cards[pile1Size - 1] & CARD_UP)) {
+					mvs->addLast(i, i, 0, 0);
+					return;
+				}
+			}
+
+			const unsigned long long KINGS = (1ull << 12) | (1ull << 25) | (1ull << 38) | (1ull << 51);
+			unsigned long long next = 0; //next card for each foundation
+			unsigned long long fits = 0; //cards that can be put on some tableau pile
+			unsigned long long run[7]; //face up cards of each tableau pile
+			unsigned long long accept[7]; //cards that can be put on each tableau pile
+			unsigned char targets[52]; //for each card the tableau piles it can be put on, one bit per pile
+			int firstEmpty = -1;
+			memset(targets, 0, sizeof(targets));
+
+			for (int i = FOUNDATION1; i <= FOUNDATION4; ++i) {
+				if (piles[i].size < 13) {
+					next |= 1ull << ((i - FOUNDATION1) * 13 + piles[i].size);
+				}
+			}
+
+			pile1 = piles + TABLEAU1;
+
+			for (int i = 0; i < 7; ++i, ++pile1) {
+				int pile1Size = pile1->size;
+				run[i] = 0;
+				accept[i] = 0;
+
+				if (pile1Size == 0) {
+					if (firstEmpty < 0) {
+						firstEmpty = TABLEAU1 + i;
+						fits |= KINGS;
+					}
+
+					continue;
+				}
+
+				for (int j = pile1->top; j < pile1Size; ++j) {
+					run[i] |= 1ull << (pile1->cards[j] & CARD_VALUE);
+				}
+
+				card1 = pile1->cards[pile1Size - 1];
+				int rank = CARD.rank[card1];
+
+				if (rank > 0) {
+					//the two cards of the other color one rank lower
+					int low = (CARD.clr[card1] ^ 1) * 13 + rank - 1;
+					accept[i] = (1ull << low) | (1ull << (low + 26));
+					targets[low] |= 1 << i;
+					targets[low + 26] |= 1 << i;
+					fits |= accept[i];
+				}
+			}
+
+			//Check tableau to foundation
+			//Check tableau to tableau
+			int wasteSize = piles[WASTE].size;
+			int stockSize = piles[STOCK].size;
+			pile1 = piles + TABLEAU1;
+			Pile* pile2;
+
+			for (int i = TABLEAU1; i <= TABLEAU7; ++i, ++pile1) {
+				int pile1Size = pile1->size;
+
+				if (pile1Size == 0) {
+					continue;
+				}
+
+				card1 = pile1->cards[pile1Size - 1];
+				int cardFoundation = 9 + CARD.suit[card1];
+
+				if ((next >> (card1 & CARD_VALUE)) & 1) {
+					//logic used to tell if we can safely move a card to its foundation
+					//this logic should only be used here and not on the talon unless we are only drawing 1 card
+					int min = (CARD.clr[card1] == 0 ? redMin : blackMin) + 2;
+
+					if (CARD.rank[card1] <= min) {
+						mvs->clear();
+						mvs->addLast(i, cardFoundation, 1, 0);
+						return;
+					}
+
+					mvs->addLast(i, cardFoundation, 1, 0);
+				}
+
+				Card card2 = pile1->cards[pile1->top];
+				int pile1Length = (CARD.rank[card2] - CARD.rank[card1] + 1);
+				unsigned long long runCards = run[i - TABLEAU1];
+				bool kingMoved = false;
+				pile2 = piles + TABLEAU1;
+
+				for (int j = TABLEAU1; j <= TABLEAU7; ++j, ++pile2) {
+					if (i == j) {
+						continue;
+					}
+
+					int pile2Size = pile2->size;
+
+					if (pile2Size == 0) {
+						if (CARD.rank[card2] != 12 || pile1Size == pile1Length || kingMoved) {
+							continue;
+						}
+
+						mvs->addLast(i, j, pile1Length, 0);
+						//only create one move for a blank spot
+						kingMoved = true;
+						continue;
+					}
+
+					//a pile of cards can be moved ontop of another pile if one of its cards fits there
+					if ((accept[j - TABLEAU1] & runCards) == 0) {
+						continue;
+					}
+
+					Card card3 = pile2->cards[pile2Size - 1];
+					int pile1Moved = (CARD.rank[card3] - CARD.rank[card1]);
+
+					if (pile1Moved == pile1Length) {//we are moving all face up cards
+						mvs->addLast(i, j, pile1Moved, 0);
+						continue;
+					}
+
+					//look to see if we are covering a card that can be moved to the foundation
+					card3 = pile1->cards[pile1Size - pile1Moved - 1];
+
+					if ((next >> (card3 & CARD_VALUE)) & 1) {
+						mvs->addLast(i, j, pile1Moved, 0);
+						continue;
+					}
+				}
+			}
+
+			//Check waste to foundation
+			//Check waste to tableau
+			if (wasteSize > 0) {
+				card1 = piles[WASTE].cards[wasteSize - 1];
+				int wasteFoundation = 9 + CARD.suit[card1];
+
+				if ((next >> (card1 & CARD_VALUE)) & 1) {
+					//should always add here if draw count is greater than 1
+					//since taking a card out of the talon changes which of the others line up with a draw
+					int min = (CARD.clr[card1] == 0 ? redMin : blackMin) + 2;
+
+					if (CARD.rank[card1] <= min && drawCount == 1) {
+						mvs->clear();
+						mvs->addLast(WASTE, wasteFoundation, 1, 0);
+						return;
+					}
+
+					mvs->addLast(WASTE, wasteFoundation, 1, 0);
+				}
+
+				addTableauMoves(mvs, WASTE, card1, 0, targets, firstEmpty);
+			}
+
+			//check foundation to tableau
+			//very rarely needed to solve optimally
+			pile1 = piles + FOUNDATION1;
+
+			for (int i = FOUNDATION1; i <= FOUNDATION4; ++i, ++pile1) {
+				int foundationSize = pile1->size;
+
+				if (foundationSize == 0) {
+					continue;
+				}
+
+				card1 = pile1->cards[foundationSize - 1];
+				int min = (CARD.clr[card1] == 0 ? redMin : blackMin) + 2;
+
+				if (CARD.rank[card1] <= min) {
+					continue;
+				}
+
+				addTableauMoves(mvs, i, card1, 0, targets, firstEmpty);
+			}
+
+			unsigned long long useful = next | fits;
+			//check the cards that can be reached by drawing from the stock, then the ones that need a redeal first
+			int entryCount;
+			const TalonTable::Entry* entry = talon->get(stockSize + wasteSize, wasteSize, &entryCount);
+			Card* wasteCards = piles[WASTE].cards;
+			Card* stockTop = piles[STOCK].cards + stockSize + wasteSize;
+
+			for (int i = 0; i < entryCount; ++i, ++entry) {
+				int end = entry->end;
+				card1 = end <= wasteSize ? wasteCards[end - 1] : stockTop[-end];
+
+				if (((useful >> (card1 & CARD_VALUE)) & 1) == 0) {
+					continue;
+				}
+
+				if ((next >> (card1 & CARD_VALUE)) & 1) {
+					int stockFoundation = 9 + CARD.suit[card1];
+					int min = (CARD.clr[card1] == 0 ? redMin : blackMin) + 2;
+					mvs->addLast(WASTE, stockFoundation, 1, entry->val);
+
+					if (CARD.rank[card1] <= min && drawCount == 1) {
+						return;
+					}
+				}
+
+				addTableauMoves(mvs, WASTE, card1, entry->val, targets, firstEmpty);
+			}
+		}
+		//original loop based move generator, KlondikeBench --check uses it to check updateMoves gives the same moves
+		//in the same order
+		void updateMovesScalar(MoveList* mvs) {
+			mvs->clear();
+			//Check flip of tableau pile
+			//Check tableau to foundation
+			//Check tableau to tableau
+			Pile* pile1 = piles + TABLEAU1;
+			Card card1;
+
+			for (int i = TABLEAU1; i <= TABLEAU7; ++i, ++pile1) {
+				int pile1Size = pile1->size;
+
+				if (pile1Size == 0) {
+					continue;
+				}
+
+				if (!(pile1->cards[pile1Size - 1] & CARD_UP)) {
+					mvs->addLast(i, i, 0, 0);
+					return;
+				}
+			}
+
+			int wasteSize = piles[WASTE].size;
+			int stockSize = piles[STOCK].size;
+			pile1 = piles + TABLEAU1;
+			Pile* pile2;
+
+			for (int i = TABLEAU1; i <= TABLEAU7; ++i, ++pile1) {
+				int pile1Size = pile1->size;
+
+				if (pile1Size == 0) {
+					continue;
+				}
+
+				card1 = pile1->cards[pile1Size - 1];
+				int cardFoundation = 9 + CARD.suit[card1];
+
+				if (CARD.rank[card1] - piles[cardFoundation].topRank() == 1) {
+					//logic used to tell if we can safely move a card to its foundation
+					//this logic should only be used here and not on the talon unless we are only drawing 1 card
+					int min = (CARD.clr[card1] == 0 ? redMin : blackMin) + 2;
+
+					if (CARD.rank[card1] <= min) {
+						mvs->clear();
+						mvs->addLast(i, cardFoundation, 1, 0);
+						return;
+					}
+
+					mvs->addLast(i, cardFoundation, 1, 0);
+				}
+
+				Card card2 = pile1->cards[pile1->top];
+				int pile1Length = (CARD.rank[card2] - CARD.rank[card1] + 1);
+				bool kingMoved = false;
+				pile2 = piles + TABLEAU1;
+
+				for (int j = TABLEAU1; j <= TABLEAU7; ++j, ++pile2) {
+					if (i == j) {
+						continue;
+					}
+
+					int pile2Size = pile2->size;
+
+					if (pile2Size == 0) {
+						if (CARD.rank[card2] != 12 || pile1Size == pile1Length || kingMoved) {
+							continue;
+						}
+
+						mvs->addLast(i, j, pile1Length, 0);
+						//only create one move for a blank spot
+						kingMoved = true;
+						continue;
+					}
+
+					Card card3 = pile2->cards[pile2Size - 1];
+
+					//logic used to determine if a pile of cards can be moved ontop of another pile of cards
+					if (CARD.rank[card1] >= CARD.rank[card3] || CARD.rank[card2] + 1 < CARD.rank[card3] || ((CARD.clr[card3] ^ CARD.clr[card1]) ^ (CARD.odd[card3] ^ CARD.odd[card1])) != 0) {
+						continue;
+					}
+
+					int pile1Moved = (CARD.rank[card3] - CARD.rank[card1]);
+
+					if (pile1Moved == pile1Length) {//we are moving all face up cards
+						mvs->addLast(i, j, pile1Moved, 0);
+						continue;
+					}
+
+					//look to see if we are covering a card that can be moved to the foundation
+					card3 = pile1->cards[pile1Size - pile1Moved - 1];
+
+					if (CARD.rank[card3] - piles[CARD.suit[card3] + 9].topRank() == 1) {
+						mvs->addLast(i, j, pile1Moved, 0);
+						continue;
+					}
+				}
+			}
+
+			//Check waste to foundation
+			//Check waste to tableau
+			if (wasteSize > 0) {
+				card1 = piles[WASTE].cards[wasteSize - 1];
+				int wasteFoundation = 9 + CARD.suit[card1];
+
+				if (CARD.rank[card1] - piles[wasteFoundation].topRank() == 1) {
+					//should always add here if draw count is greater than 1
+					int min = (CARD.clr[card1] == 0 ? redMin : blackMin) + 2;
+
+					if (CARD.rank[card1] <= min && drawCount == 1) {
+						mvs->clear();
+						mvs->addLast(WASTE, wasteFoundation, 1, 0);
+						return;
+					}
+
+					mvs->addLast(WASTE, wasteFoundation, 1, 0);
+				}
+
+				pile1 = piles + TABLEAU1;
+
+				for (int i = TABLEAU1; i <= TABLEAU7; ++i, ++pile1) {
+					int size = pile1->size;
+
+					if (size != 0) {
+						Card card = pile1->cards[size - 1];
+
+						if (!(card & CARD_UP) || CARD.rank[card] - CARD.rank[card1] != 1 || CARD.clr[card] == CARD.clr[card1]) {
+							continue;
+						}
+
+						mvs->addLast(WASTE, i, 1, 0);
+						continue;
+					}
+
+					if (CARD.rank[card1] != 12) {
+						continue;
+					}
+
+					mvs->addLast(WASTE, i, 1, 0);
+					break;
+				}
+			}
+
+			//check foundation to tableau
+			//very rarely needed to solve optimally
+			pile1 = piles + FOUNDATION1;
+
+			for (int i = FOUNDATION1; i <= FOUNDATION4; ++i, ++pile1) {
+				int foundationSize = pile1->size;
+
+				if (foundationSize == 0) {
+					continue;
+				}
+
+				card1 = pile1->cards[foundationSize - 1];
+				int min = (CARD.clr[card1] == 0 ? redMin : blackMin) + 2;
+
+				if (CARD.rank[card1] <= min) {
+					continue;
+				}
+
+				pile2 = piles + TABLEAU1;
+
+				for (int j = TABLEAU1; j <= TABLEAU7; ++j, ++pile2) {
+					int size = pile2->size;
+
+					if (size != 0) {
+						Card card = pile2->cards[size - 1];
+
+						if (!(card & CARD_UP) || CARD.rank[card] - CARD.rank[card1] != 1 || CARD.clr[card] == CARD.clr[card1]) {
+							continue;
+						}
+
+						mvs->addLast(i, j, 1, 0);
+						continue;
+					}
+
+					if (CARD.rank[card1] != 12) {
+						continue;
+					}
+
+					mvs->addLast(i, j, 1, 0);
+					break;
+				}
+			}
+
+			//drawing several cards at a time reaches the cards the talon table lists, in its order
+			if (drawCount > 1) {
+				int entryCount;
+				const TalonTable::Entry* entry = talon->get(stockSize + wasteSize, wasteSize, &entryCount);
+
+				for (int j = 0; j < entryCount; ++j, ++entry) {
+					int end = entry->end;
+					card1 = end <= wasteSize ? piles[WASTE].cards[end - 1] : piles[STOCK].cards[stockSize + wasteSize - end];
+					int stockFoundation = 9 + CARD.suit[card1];
+
+					if (CARD.rank[card1] - piles[stockFoundation].topRank() == 1) {
+						mvs->addLast(WASTE, stockFoundation, 1, entry->val);
+					}
+
+					pile2 = piles + TABLEAU1;
+
+					for (int i = TABLEAU1; i <= TABLEAU7; ++i, ++pile2) {
+						int size = pile2->size;
+
+						if (size != 0) {
+							Card card = pile2->cards[size - 1];
+
+							if (!(card & CARD_UP) || CARD.rank[card] - CARD.rank[card1] != 1 || CARD.clr[card] == CARD.clr[card1]) {
+								continue;
+							}
+
+							mvs->addLast(WASTE, i, 1, entry->val);
+							continue;
+						}
+
+						if (CARD.rank[card1] != 12) {
+							continue;
+						}
+
+						mvs->addLast(WASTE, i, 1, entry->val);
+						break;
+					}
+				}
+
+				return;
+			}
+
+			//check cards waiting to be turned over from stock
+			pile1 = piles + STOCK;
+
+			for (int j = stockSize - 1; j >= 0; --j) {
+				card1 = pile1->cards[j];
+				int stockFoundation = 9 + CARD.suit[card1];
+
+				if (CARD.rank[card1] - piles[stockFoundation].topRank() == 1) {
+					int min = (CARD.clr[card1] == 0 ? redMin : blackMin) + 2;
+
+					if (CARD.rank[card1] <= min) {
+						mvs->addLast(WASTE, stockFoundation, 1, stockSize - j);
+						return;
+					}
+
+					mvs->addLast(WASTE, stockFoundation, 1, stockSize - j);
+				}
+
+				pile2 = piles + TABLEAU1;
+
+				for (int i = TABLEAU1; i <= TABLEAU7; ++i, ++pile2) {
+					int size = pile2->size;
+
+					if (size != 0) {
+						Card card = pile2->cards[size - 1];
+
+						if (!(card & CARD_UP) || CARD.rank[card] - CARD.rank[card1] != 1 || CARD.clr[card] == CARD.clr[card1]) {
+							continue;
+						}
+
+						mvs->addLast(WASTE, i, 1, stockSize - j);
+						continue;
+					}
+
+					if (CARD.rank[card1] != 12) {
+						continue;
+					}
+
+					mvs->addLast(WASTE, i, 1, stockSize - j);
+					break;
+				}
+			}
+
+			//check cards already turned over in the waste
+			//meaning we have to "redeal" the deck to get to it
+			pile1 = piles + WASTE;
+			--wasteSize;
+
+			for (int j = 0; j < wasteSize; ++j) {
+				card1 = pile1->cards[j];
+				int stockFoundation = 9 + CARD.suit[card1];
+
+				if (CARD.rank[card1] - piles[stockFoundation].topRank() == 1) {
+					int min = (CARD.clr[card1] == 0 ? redMin : blackMin) + 2;
+
+					if (CARD.rank[card1] <= min) {
+						mvs->addLast(WASTE, stockFoundation, 1, stockSize + j + 1);
+						return;
+					}
+
+					mvs->addLast(WASTE, stockFoundation, 1, stockSize + j + 1);
+				}
+
+				pile2 = piles + TABLEAU1;
+
+				for (int i = TABLEAU1; i <= TABLEAU7; ++i, ++pile2) {
+					int size = pile2->size;
+
+					if (size != 0) {
+						Card card = pile2->cards[size - 1];
+
+						if (!(card & CARD_UP) || CARD.rank[card] - CARD.rank[card1] != 1 || CARD.clr[card] == CARD.clr[card1]) {
+							continue;
+						}
+
+						mvs->addLast(WASTE, i, 1, stockSize + j + 1);
+						continue;
+					}
+
+					if (CARD.rank[card1] != 12) {
+						continue;
+					}
+
+					mvs->addLast(WASTE, i, 1, stockSize + j + 1);
+					break;
+				}
+			}
+		}
+		//moves spent drawing before a talon move that turns over val cards. a redeal is not counted as a move
+		int drawCost(int val) {
+			if (drawCount == 1) {
+				return val;
+			}
+
+			int stock = piles[STOCK].size;
+
+			if (val <= stock) {
+				return (val + drawCount - 1) / drawCount;
+			}
+
+			return (stock + drawCount - 1) / drawCount + (val - stock + drawCount - 1) / drawCount;
+		}
+		//set minimum ranks in foundation
+		void setFoundationMin() {
+			int one = piles[FOUNDATION2].topRank();
+			int two = piles[FOUNDATION4].topRank();
+			redMin = one <= two ? one : two;
+			one = piles[FOUNDATION1].topRank();
+			two = piles[FOUNDATION3].topRank();
+			blackMin = one <= two ? one : two;
+		}
+		//heuristic function used to determine lower bound of moves needed.
+		//the waste and tableau parts are kept in pileWins by makeMove and undoMove, the pattern table adds the moves
+		//the order the face down cards can leave their piles in costs on top of that
+		int minWinAt() {
+			//every stock card has to be played and at least one draw is needed for each drawCount of them
+			return piles[STOCK].size + (piles[STOCK].size + drawCount - 1) / drawCount + winSum
+				+ (downBonus != NULL ? downBonus[downState] : 0);
+		}
+		//the part of minWinAt for the waste or a tableau pile. every card has to be moved and every face down card turned
+		//over, and a card with a lower card of its suit under it has to be moved once more to free that card.
+		//each face down or waste card is counted on its own but a face up run adds one more move at most
+		int pileWin(int i) {
+			Pile* pile = piles + i;
+			int size = pile->size;
+
+			if (i == WASTE) {
+				int win = size;
+				signed char low[4] = {13, 13, 13, 13};
+				countLower(pile, size, low, &win);
+				return win;
+			}
+
+			int top = pile->top < 0 ? size : pile->top;
+			int win = size + downWins[i];
+			signed char* low = downLow[i];
+
+			for (int j = size - 1; j >= top; --j) {
+				Card card = pile->cards[j];
+
+				if (CARD.rank[card] > low[CARD.suit[card]]) {
+					++win;
+					break;
+				}
+			}
+
+			return win;
+		}
+		//work out downWins and downLow for a tableau pile
+		void scoreDown(int i) {
+			Pile* pile = piles + i;
+			int top = pile->top < 0 ? pile->size : pile->top;
+			int win = top;
+			memset(downLow[i], 13, sizeof(downLow[i]));
+			countLower(pile, top, downLow[i], &win);
+			downWins[i] = win;
+			downState += (top - downState / DOWN_RADIX[i] % i) * DOWN_RADIX[i];
+		}
+		//add one to win for each of the bottom count cards of a pile with a lower card of its suit under it,
+		//low is the lowest rank of each suit seen so far
+		void countLower(Pile* pile, int count, signed char* low, int* win) {
+			for (int j = 0; j < count; ++j) {
+				Card card = pile->cards[j];
+				int suit = CARD.suit[card];
+
+				if (CARD.rank[card] > low[suit]) {
+					++*win;
+				} else {
+					low[suit] = CARD.rank[card];
+				}
+			}
+		}
+		//minWinAt worked out from scratch with a scan of every pile, used to check the kept parts against
+		int minWinAtScan() {
+			int win = piles[STOCK].size + (piles[STOCK].size + drawCount - 1) / drawCount + piles[WASTE].size;
+			int state = 0;
+			Card ctmp1, ctmp2;
+			Pile* p = piles + WASTE;
+			
+			for (int i = p->size - 1; i >= 0; --i) {
+				ctmp1 = p->cards[i];
+				
+				for (int j = i - 1; j >= 0; --j) {
+					ctmp2 = p->cards[j];
+
+					if (CARD.suit[ctmp1] == CARD.suit[ctmp2] && CARD.rank[ctmp1] > CARD.rank[ctmp2]) {
+						++win;
+						break;
+					}
+				}
+			}
+
+			p = piles + TABLEAU1;
+
+			for (int i = TABLEAU1; i <= TABLEAU7; ++i, ++p) {
+				int temp = p->size;
+				int top = p->top < 0 ? temp : p->top;
+				win += temp + top;
+				state += top * DOWN_RADIX[i];
+
+				while ((--temp) >= 0) {
+					ctmp1 = p->cards[temp];
+
+					for (int j = (top < temp ? top - 1 : temp - 1); j >= 0; --j) {
+						ctmp2 = p->cards[j];
+
+						if (CARD.suit[ctmp1] == CARD.suit[ctmp2] && CARD.rank[ctmp1] > CARD.rank[ctmp2]) {
+							++win;
+
+							if (top < temp) {
+								temp = top;
+							}
+
+							break;
+						}
+					}
+				}
+			}
+
+			return win + (downBonus != NULL ? downBonus[state] : 0);
+		}
+		int shuffle(int seed = -1) {
+			if (seed != -1) {
+				random.setSeed(seed);
+			} else {
+				seed = random.next();
+				random.setSeed(seed);
+			}
+
+			int temp;
+
+			for (int x = 0; x < 250; ++x) {
+				int k = random.next() % 52;
+				int j = random.next() % 52;
+				temp = cards[k];
+				cards[k] = cards[j];
+				cards[j] = temp;
+			}
+
+			reset();
+			findPatterns();
+			return seed;
+		}
+		bool load(char* cardSet) {
+			for (int i = 0; i < 52; i++) {
+				int suit = (cardSet[i * 3 + 2] ^ 0x30) - 1;
+
+				if (suit < 0 || suit > 3) {
+					return false;
+				}
+
+				if (suit >= 2) {
+					suit = (suit == 2) ? 3 : 2;
+				}
+
+				int rank = (cardSet[i * 3] ^ 0x30) * 10 + (cardSet[i * 3 + 1] ^ 0x30) - 1;
+
+				if (rank < 0 || rank > 12) {
+					return false;
+				}
+
+				cards[i] = suit * 13 + rank;
+			}
+
+			reset();
+			findPatterns();
+			return true;
+		}
+		//write the deal in the format load reads, 156 digits
+		void save(char* cardSet) {
+			for (int i = 0; i < 52; i++) {
+				int suit = cards[i] / 13;
+				int rank = cards[i] % 13 + 1;
+
+				if (suit >= 2) {
+					suit = (suit == 2) ? 3 : 2;
+				}
+
+				cardSet[i * 3] = 0x30 + rank / 10;
+				cardSet[i * 3 + 1] = 0x30 + rank % 10;
+				cardSet[i * 3 + 2] = 0x30 + suit + 1;
+			}
+		}
+		void print() {
+			for (int i = 0; i < 13; i++) {
+				printf("%2i: ", i);
+				piles[i].print();
+				printf("\n");
+				fflush(stdout);
+			}
+
+			moves.print();
+			printf("\nMinWinAt: %i\n", minWinAt());
+			fflush(stdout);
+		}
+		//tell why a search stopped early and print the moves to the best position it reached
+		void showStop() {
+			if (result.stop != STOP_EXHAUSTED && result.stop != STOP_MEMORY) {
+				printf("Stopped: %s Nodes: %lld Bound: %i F: %i\n", STOP_NAMES[result.stop], result.nodes, result.bound, result.bestF);
+
+				if (bestPath.size > 0) {
+					bestPath.printPacked(drawCount);
+					printf("\n");
+				}
+			}
+
+			fflush(stdout);
+		}
+		//IDA* implementation to solve specified deal.
+		//with more than one thread, each thread pulls a few nodes off the open list and searches under them on its own,
+		//merging its children back in batches and handing half its nodes to threads that run dry. the closed set is
+		//shared and a depth bound is only raised once all threads have run out of nodes so the solution is still optimal.
+		//memory is the most megabytes the closed set and open list may use, half each, 0 for no limit.
+		//a full closed set evicts the states reached in the most moves, which only slows the search down. a full open
+		//list stops it and sets memoryFull.
+		//limits can stop the search early, result tells why it stopped and how far it got.
+		//with a checkpoint the search is saved to its file every so often and when a limit stops it, and the file
+		//is removed once the search is over. with resume set a search saved there for the same deal, draw count
+		//and memory limit is carried on where it was, and max is not used.
+		int solve(int* max, bool show = false, int threads = 1, int memory = 0, const SolveLimits* limits = NULL, const Checkpoint* checkpoint = NULL) {
+			long long start = microTime();
+			stats.clear();
+			prepare(memory);
+			solution.clear();
+			bestPath.clear();
+			reset();
+
+			Search search;
+			search.closed = closed;
+			search.open = open;
+			search.solution = &solution;
+			search.mm = *max;
+			search.bestF = 0;
+			search.busy = 0;
+			search.running = 0;
+			search.waiting = 0;
+			search.saving = false;
+			search.moves = -1;
+			search.show = show;
+			search.done = false;
+			search.full = false;
+			search.stop = STOP_EXHAUSTED;
+			search.nodes = 0;
+			search.limits.start(limits, start);
+			search.bestPath = &bestPath;
+			search.stats = &stats;
+			search.checkpoint = checkpoint != NULL && checkpoint->filename != NULL ? checkpoint : NULL;
+			search.nextSave = search.checkpoint != NULL && checkpoint->seconds > 0 ? start + checkpoint->seconds * 1000000LL : 0;
+
+			bool resumed = search.checkpoint != NULL && checkpoint->resume && loadCheckpoint(&search);
+
+			if (resumed && show) {
+				printf("Resumed: %i OS-OT: %i-%i CS: %i F: %i\n", search.mm, open->size, open->top, closed->size(), search.bestF);
+				fflush(stdout);
+			} else if (!resumed) {
+				if (search.checkpoint != NULL && checkpoint->resume) {
+					closed->clear();
+					open->clear();
+				}
+
+				int wa = minWinAt();
+				closed->addLower(this, closedHash(), wa);
+				open->add(-1, -1, -1, wa << 12);
+			}
+
+			search.current = stats.next(search.mm);
+			search.current->openStart = open->size;
+			search.current->openTop = open->top;
+			search.iterationStart = microTime();
+			stats.setupUs = search.iterationStart - start;
+			pthread_mutex_init(&search.lock, NULL);
+			pthread_cond_init(&search.wake, NULL);
+
+			if (threads > 1) {
+				if (helperCount < threads - 1) {
+					for (int i = 0; i < helperCount; ++i) {
+						delete helpers[i];
+					}
+
+					delete []helpers;
+					helperCount = threads - 1;
+					helpers = new Solitaire*[helperCount];
+
+					for (int i = 0; i < helperCount; ++i) {
+						helpers[i] = new Solitaire(drawCount);
+					}
+				}
+
+				pthread_t* ids = new pthread_t[threads - 1];
+				SearchArg* args = new SearchArg[threads - 1];
+
+				for (int i = 0; i < threads - 1; ++i) {
+					helpers[i]->copyDeal(this);
+					args[i].game = helpers[i];
+					args[i].search = &search;
+					pthread_create(ids + i, NULL, searchMain, args + i);
+				}
+
+				this->search(&search);
+
+				for (int i = 0; i < threads - 1; ++i) {
+					pthread_join(ids[i], NULL);
+				}
+
+				delete []ids;
+				delete []args;
+			} else {
+				this->search(&search);
+			}
+
+			pthread_mutex_destroy(&search.lock);
+			pthread_cond_destroy(&search.wake);
+
+			if (search.checkpoint != NULL) {
+				if (search.stop == STOP_NODES || search.stop == STOP_TIME || search.stop == STOP_CANCELLED) {
+					saveCheckpoint(&search);
+				} else {
+					remove(checkpoint->filename);
+				}
+			}
+
+			memoryFull = search.full;
+			result.stop = search.stop;
+			result.moves = search.moves;
+			result.bestF = search.moves >= 0 ? 52 : search.bestF;
+			result.bound = search.moves >= 0 ? search.moves : search.mm;
+			result.nodes = search.nodes;
+			long long end = microTime();
+			search.current->openEnd = open->size;
+			search.current->searchUs = end - search.iterationStart;
+			stats.totalUs = end - start;
+			stats.closedSize = closed->size();
+			stats.closedLevels = closed->levelsUsed();
+			stats.openResizes = open->resizes;
+			stats.memory = closed->memory() + open->memory();
+			rusage usage;
+			getrusage(RUSAGE_SELF, &usage);
+			stats.maxRssKb = usage.ru_maxrss;
+
+			if (show && (memoryFull || closed->isFull())) {
+				long long evicted = 0;
+
+				for (int i = 0; i < stats.count; ++i) {
+					evicted += stats.iterations[i].evicted;
+				}
+
+				printf("Memory limit of %i MB reached: %s\n", memory, search.full ? "open list full, search stopped" : "closed set full");
+				printf("Closed set states evicted: %lld\n", evicted);
+				fflush(stdout);
+			}
+
+			if (search.moves >= 0) {
+				if (show) {
+					solution.printPacked(drawCount);
+					printf("\n");
+					solution.printPretty(drawCount);
+					printf("\n");
+					fflush(stdout);
+				}
+
+				*max = search.moves;
+				return 52;
+			}
+
+			*max = search.mm;
+
+			if (show) {
+				printf("Failed. OS-OT: %i-%i CS: %i F: %i\n", open->size, open->top, closed->size(), search.bestF);
+				showStop();
+			}
+
+			return search.bestF;
+		}
+		//greedy search that returns the first solution it finds instead of the shortest one. it goes depth first, trying
+		//the moves with the lowest moves used plus twice minWinAt after them first, and never expands a position twice.
+		//memory, limits and the result work as in solve, max is also the same except it is 0 when no solution was found.
+		int solveFast(int* max, bool show = false, int memory = 0, const SolveLimits* limits = NULL) {
+			return depthFirst(max, show, memory, limits, false);
+		}
+		//whether the deal can be won at all: 1 if it can, with the moves of a solution that is likely far from the
+		//shortest one in solution, 0 if it cannot and -1 if the search stopped at a limit first.
+		//result is filled in as by solveFast, memory and limits also work the same
+		int prove(bool show = false, int memory = 0, const SolveLimits* limits = NULL) {
+			int moves;
+			depthFirst(&moves, show, memory, limits, true);
+
+			if (result.stop == STOP_SOLVED) {
+				return 1;
+			}
+
+			return result.stop == STOP_EXHAUSTED && !proofCut ? 0 : -1;
+		}
+		//copy the current position out or back in
+		void savePosition(Position* to) {
+			memcpy(to, (Position*)this, sizeof(Position));
+		}
+		void restorePosition(const Position* from) {
+			memcpy((Position*)this, from, sizeof(Position));
+		}
+		//take the deal from another game and go back to its initial state
+		void copyDeal(Solitaire* from) {
+			for (int i = 0; i < 52; ++i) {
+				cards[i] = from->cards[i];
+			}
+
+			reset();
+			patterns = from->patterns;
+			downBonus = from->downBonus;
+			suitSwaps = from->suitSwaps;
+		}
+		//the deal as it was loaded, suit * 13 + rank for each card
+		const Card* dealCards() const {
+			return cards;
+		}
+		//look deals up in a pattern file from now on, NULL to stop
+		void usePatterns(const PatternFile* file) {
+			patterns = file;
+			findPatterns();
+		}
+		//let positions with the suits of a colour traded share a closed set entry, see key
+		void useSuitSwaps(bool on) {
+			suitSwaps = on;
+		}
+		//the face down cards of the deal in the order PatternEntry keeps them
+		void downCards(Card* down) {
+			for (int j = TABLEAU1, i = 0; j <= TABLEAU7; ++j) {
+				for (int k = j; k <= TABLEAU7; ++k, ++i) {
+					if (k > j) {
+						down[(k - TABLEAU2) * (k - TABLEAU1) / 2 + j - TABLEAU1] = cards[i];
+					}
+				}
+			}
+		}
+	private:
+		void findPatterns() {
+			Card down[DOWN_CARDS];
+			downCards(down);
+			downBonus = patterns != NULL ? patterns->find(down) : NULL;
+		}
+};
+
+//milliseconds passed since start
+int elapsed(timeb* start) {
+	timeb now;
+	ftime(&now);
+	return (now.time - start->time) * 1000L + (now.millitm - start->millitm);
+}
 
-				++cur;
-				fuc += piles[cur].faceUpCount();
-			}
+//read one line of a deck file into cardSet skipping anything after //
+//returns the number of digits found on the line or -1 when there are no more lines
+int readDeckLine(FILE* f, char* cardSet) {
+	int c1, c2 = ' ', i = 0;
+	bool any = false;
 
-			char* comp = new char[4 + fuc];
-			int z = 0;
-			comp[z++] = (piles[WASTE].size + 1);
-			comp[z++] = (piles[FOUNDATION1].size << 4) | (piles[FOUNDATION2].size + 1);
-			comp[z++] = (piles[FOUNDATION3].size << 4) | (piles[FOUNDATION4].size + 1);
-			Pile* pile;
+	while ((c1 = fgetc(f)) != EOF) {
+		any = true;
 
-			for (int i = 0; i < 7; ++i) {
-				pile = piles + order[i];
+		if (c1 == '\n') {
+			break;
+		}
 
-				if (pile->top >= 0) {
-					for (int i = pile->top; i < pile->size; ++i) {
-						comp[z++] = pile->cards[i]->value + 1;
-					}
-					comp[z - 1] |= 128;
-				}
-			}
-			
-			comp[z] = 0;
-			return comp;
+		if (c1 == '/' && c2 == '/') {
+			while ((c1 = fgetc(f)) != EOF && c1 != '\n') {}
+			break;
 		}
-		//make a series of moves
-		void makeMove(Move* move) {
-			do {
-				makeMove(move->from, move->to, move->cards, move->val);
-				move = move->next;
-			} while (move != NULL);
+
+		c2 = c1;
+
+		if (c1 < 0x30 || c1 > 0x39) {
+			continue;
 		}
-		//make a single move
-		bool makeMove(int from, int to, int cardsMoved, int val) {
-			bool thru = false;
 
-			if (from != to) {
-				if (val > 0) {
-					if (piles[STOCK].removeTop(piles + WASTE, val, false)) {
-						++rounds;
-						thru = true;
-					}
-				}
+		if (i < 156) {
+			cardSet[i] = c1;
+		}
+		++i;
+	}
 
-				if (cardsMoved == 1) {
-					piles[from].remove(piles + to);
+	return any ? i : -1;
+}
 
-					if (to >= FOUNDATION1) {
-						++foundationCount;
-						setFoundationMin();
-					} else if (from >= FOUNDATION1) {
-						--foundationCount;
-						setFoundationMin();
-					}
-				} else {
-					piles[from].remove(piles + to, cardsMoved);
-				}
-			} else {
-				piles[from].flip();
+//what a SolutionCache record says about its deal
+enum CacheStatus {
+	CACHE_SOLVED = 1, //pack holds a shortest solution
+	CACHE_UNSOLVABLE //prove showed the deal can not be won
+};
+
+//a deal's entry in a SolutionCache file
+struct CacheRecord {
+	Card cards[52]; //the deal with its suits swapped to the form it is stored under
+	unsigned char drawCount, status;
+	short moves, found;
+	int ms; //time the search of the deal took
+	long long nodes; //positions it expanded
+	char pack[3 * MAX_PATH + 3]; //packed solution for cards, empty if there is none
+};
+
+//results of earlier runs kept on disk, keyed by the deal and draw count. the file is a header and fixed size records,
+//each added with a single append so several processes can share it. records already in the file when it is opened
+//are mapped read only and ones added since are kept in memory too, and all of them are looked up through a hash index.
+//a deal that is not found is looked up again after reading the records other processes have appended in the meantime.
+//swapping the two black suits or the two red suits gives a deal with the same solutions, so a deal is stored in
+//whichever of its four forms sorts first and a packed solution only needs its foundations swapped back.
+class SolutionCache {
+	private:
+		struct Header {
+			char magic[4];
+			int recordSize;
+		};
+
+		int fd;
+		void* map;
+		size_t mapSize;
+		const CacheRecord* mapped; //records in the file when it was opened
+		int mappedCount;
+		CacheRecord* added; //records added since, by this process or read from the file
+		int addedCount, addedCapacity;
+		off_t readEnd; //where the records not read yet start in the file
+		int* slots; //record numbers by hash, -1 for a free slot
+		int slotMask;
+		pthread_mutex_t lock;
+
+		const CacheRecord* record(int i) const {
+			return i < mappedCount ? mapped + i : added + i - mappedCount;
+		}
+		static unsigned int hash(const Card* cards, int drawCount) {
+			unsigned int h = 2166136261u ^ drawCount;
+
+			for (int i = 0; i < 52; ++i) {
+				h = (h ^ cards[i]) * 16777619u;
 			}
 
-			return thru;
+			return h;
 		}
-		//undo a single move. thru is set to true if we made a move that increased the number of rounds.
-		void undoMove(int from, int to, int cardsMoved, int val, bool thru) {
-			if (from != to) {
-				if (cardsMoved == 1) {
-					piles[to].remove(piles + from);
+		//suit after a swap, bit 0 swaps clubs and spades and bit 1 diamonds and hearts
+		static int swapSuit(int suit, int swap) {
+			return (swap >> (suit & 1)) & 1 ? suit ^ 2 : suit;
+		}
+		//the form of a deal it is stored under, returns the swap that turns the deal into it and back
+		static int canonical(const Card* cards, Card* to) {
+			Card form[52];
+			int best = 0;
+			memcpy(to, cards, 52);
+
+			for (int swap = 1; swap < 4; ++swap) {
+				for (int i = 0; i < 52; ++i) {
+					form[i] = swapSuit(cards[i] / 13, swap) * 13 + cards[i] % 13;
+				}
 
-					if (to >= FOUNDATION1) {
-						--foundationCount;
-						setFoundationMin();
-					} else if (from >= FOUNDATION1) {
-						++foundationCount;
-						setFoundationMin();
-					}
-				} else {
-					piles[to].remove(piles + from, cardsMoved);
+				if (memcmp(form, to, 52) < 0) {
+					memcpy(to, form, 52);
+					best = swap;
 				}
+			}
 
-				if (val > 0) {
-					if (piles[WASTE].removeTop(piles + STOCK, val, thru)) {
-						--rounds;
+			return best;
+		}
+		static void swapPack(char* pack, int swap) {
+			for (char* z = pack + 2; z[0] != 0 && z[1] != 0 && z[2] != 0; z += 3) {
+				for (int k = 0; k < 2; ++k) {
+					if (z[k] - 0x30 >= FOUNDATION1) {
+						z[k] = 0x30 + FOUNDATION1 + swapSuit(z[k] - 0x30 - FOUNDATION1, swap);
 					}
 				}
-			} else {
-				piles[to].flip();
 			}
 		}
-		//determine available moves.
-		void updateMoves(MoveList* mvs) {
-			mvs->clear();
-			//Check flip of tableau pile
-			//Check tableau to foundation
-			//Check tableau to tableau
-			Pile* pile1 = piles + TABLEAU1;
-			Card* card1;
-
-			for (int i = TABLEAU1; i <= TABLEAU7; ++i, ++pile1) {
-				int pile1Size = pile1->size;
+		int lookup(const Card* cards, int drawCount) const {
+			for (int i = hash(cards, drawCount) & slotMask; slots[i] >= 0; i = (i + 1) & slotMask) {
+				const CacheRecord* r = record(slots[i]);
 
-				if (pile1Size == 0) {
-					continue;
+				if (r->drawCount == drawCount && memcmp(r->cards, cards, 52) == 0) {
+					return slots[i];
 				}
+			}
 
-				if (!pile1->cards[pile1Size - 1]->up) {
-					mvs->addLast(i, i, 0, 0);
-					return;
+			return -1;
+		}
+		void index(int n) {
+			if ((n + 1) * 2 > slotMask + 1) {
+				delete []slots;
+				slotMask = slotMask * 2 + 1;
+				slots = new int[slotMask + 1];
+				memset(slots, -1, (slotMask + 1) * sizeof(int));
+
+				for (int i = 0; i < n; ++i) {
+					index(i);
 				}
 			}
 
-			int wasteSize = piles[WASTE].size;
-			int stockSize = piles[STOCK].size;
-			pile1 = piles + TABLEAU1;
-			Pile* pile2;
+			const CacheRecord* r = record(n);
+			int i = hash(r->cards, r->drawCount) & slotMask;
 
-			for (int i = TABLEAU1; i <= TABLEAU7; ++i, ++pile1) {
-				int pile1Size = pile1->size;
+			while (slots[i] >= 0) {
+				i = (i + 1) & slotMask;
+			}
 
-				if (pile1Size == 0) {
-					continue;
-				}
+			slots[i] = n;
+		}
+		void keep(const CacheRecord* r) {
+			if (addedCount == addedCapacity) {
+				CacheRecord* larger = new CacheRecord[addedCapacity << 1];
+				memcpy(larger, added, addedCount * sizeof(CacheRecord));
+				delete []added;
+				added = larger;
+				addedCapacity <<= 1;
+			}
 
-				card1 = pile1->cards[pile1Size - 1];
-				int cardFoundation = 9 + card1->suit;
+			added[addedCount++] = *r;
+			index(mappedCount + addedCount - 1);
+		}
+		//keep the whole records appended to the file since it was last read, ours among them are there already
+		void refresh() {
+			struct stat st;
+			CacheRecord r;
 
-				if (card1->rank - piles[cardFoundation].topRank() == 1) {
-					//logic used to tell if we can safely move a card to its foundation
-					//this logic should only be used here and not on the talon unless we are only drawing 1 card
-					int min = (card1->clr == 0 ? redMin : blackMin) + 2;
+			if (fd < 0 || fstat(fd, &st) != 0) {
+				return;
+			}
 
-					if (card1->rank <= min) {
-						mvs->clear();
-						mvs->addLast(i, cardFoundation, 1, 0);
-						return;
-					}
+			while (readEnd + (off_t)sizeof(CacheRecord) <= st.st_size && pread(fd, &r, sizeof(r), readEnd) == sizeof(r)) {
+				readEnd += sizeof(r);
 
-					mvs->addLast(i, cardFoundation, 1, 0);
+				if (lookup(r.cards, r.drawCount) < 0) {
+					keep(&r);
 				}
+			}
+		}
+	public:
+		SolutionCache() {
+			fd = -1;
+			map = NULL;
+			mapSize = 0;
+			mapped = NULL;
+			mappedCount = 0;
+			addedCapacity = 64;
+			addedCount = 0;
+			added = new CacheRecord[addedCapacity];
+			readEnd = 0;
+			slotMask = 127;
+			slots = new int[slotMask + 1];
+			memset(slots, -1, (slotMask + 1) * sizeof(int));
+			pthread_mutex_init(&lock, NULL);
+		}
+		~SolutionCache() {
+			if (map != NULL) {
+				munmap(map, mapSize);
+			}
 
-				Card* card2 = pile1->cards[pile1->top];
-				int pile1Length = (card2->rank - card1->rank + 1);
-				bool kingMoved = false;
-				pile2 = piles + TABLEAU1;
-
-				for (int j = TABLEAU1; j <= TABLEAU7; ++j, ++pile2) {
-					if (i == j) {
-						continue;
-					}
-
-					int pile2Size = pile2->size;
-
-					if (pile2Size == 0) {
-						if (card2->rank != 12 || pile1Size == pile1Length || kingMoved) {
-							continue;
-						}
-
-						mvs->addLast(i, j, pile1Length, 0);
-						//only create one move for a blank spot
-						kingMoved = true;
-						continue;
-					}
+			if (fd >= 0) {
+				close(fd);
+			}
 
-					Card* card3 = pile2->cards[pile2Size - 1];
+			delete []added;
+			delete []slots;
+			pthread_mutex_destroy(&lock);
+		}
 
-					//logic used to determine if a pile of cards can be moved ontop of another pile of cards
-					if (card1->rank >= card3->rank || card2->rank + 1 < card3->rank || ((card3->clr ^ card1->clr) ^ (card3->odd ^ card1->odd)) != 0) {
-						continue;
-					}
+		//open or create a cache file, false if it can not be or is not one. a record cut short when a run
+		//was killed is dropped
+		bool open(const char* filename) {
+			fd = ::open(filename, O_RDWR | O_CREAT | O_APPEND, 0644);
+			struct stat st;
 
-					int pile1Moved = (card3->rank - card1->rank);
+			if (fd < 0 || fstat(fd, &st) != 0) {
+				return false;
+			}
 
-					if (pile1Moved == pile1Length) {//we are moving all face up cards
-						mvs->addLast(i, j, pile1Moved, 0);
-						continue;
-					}
+			Header header;
 
-					//look to see if we are covering a card that can be moved to the foundation
-					card3 = pile1->cards[pile1Size - pile1Moved - 1];
+			if (st.st_size == 0) {
+				memcpy(header.magic, "KSOL", 4);
+				header.recordSize = sizeof(CacheRecord);
+				readEnd = sizeof(header);
+				return write(fd, &header, sizeof(header)) == sizeof(header);
+			}
 
-					if (card3->rank - piles[card3->suit + 9].topRank() == 1) {
-						mvs->addLast(i, j, pile1Moved, 0);
-						continue;
-					}
-				}
+			if (pread(fd, &header, sizeof(header), 0) != sizeof(header) || memcmp(header.magic, "KSOL", 4) != 0
+					|| header.recordSize != (int)sizeof(CacheRecord)) {
+				return false;
 			}
 
-			//Check waste to foundation
-			//Check waste to tableau
-			if (wasteSize > 0) {
-				card1 = piles[WASTE].cards[wasteSize - 1];
-				int wasteFoundation = 9 + card1->suit;
+			int count = (st.st_size - sizeof(Header)) / sizeof(CacheRecord);
+			size_t size = sizeof(Header) + (size_t)count * sizeof(CacheRecord);
 
-				if (card1->rank - piles[wasteFoundation].topRank() == 1) {
-					//should always add here if draw count is greater than 1
-					int min = (card1->clr == 0 ? redMin : blackMin) + 2;
+			if ((size_t)st.st_size != size && ftruncate(fd, size) != 0) {
+				return false;
+			}
 
-					if (card1->rank <= min) {
-						mvs->clear();
-						mvs->addLast(WASTE, wasteFoundation, 1, 0);
-						return;
-					}
+			if (count > 0) {
+				void* data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
 
-					mvs->addLast(WASTE, wasteFoundation, 1, 0);
+				if (data == MAP_FAILED) {
+					return false;
 				}
 
-				pile1 = piles + TABLEAU1;
-
-				for (int i = TABLEAU1; i <= TABLEAU7; ++i, ++pile1) {
-					int size = pile1->size;
-
-					if (size != 0) {
-						Card* card = pile1->cards[size - 1];
+				map = data;
+				mapSize = size;
+				mapped = (const CacheRecord*)((char*)data + sizeof(Header));
+			}
 
-						if (!card->up || card->rank - card1->rank != 1 || card->clr == card1->clr) {
-							continue;
-						}
+			mappedCount = count;
+			readEnd = size;
 
-						mvs->addLast(WASTE, i, 1, 0);
-						continue;
-					}
+			for (int i = 0; i < count; ++i) {
+				index(i);
+			}
 
-					if (card1->rank != 12) {
-						continue;
-					}
+			return true;
+		}
+		//copy the record of a deal with its solution turned back to the deal's suits, false if there is none
+		bool find(const Card* cards, int drawCount, CacheRecord* to) {
+			Card form[52];
+			int swap = canonical(cards, form);
+			pthread_mutex_lock(&lock);
+			int n = lookup(form, drawCount);
+
+			if (n < 0) {
+				refresh();
+				n = lookup(form, drawCount);
+			}
 
-					mvs->addLast(WASTE, i, 1, 0);
-					break;
-				}
+			if (n >= 0) {
+				memcpy(to, record(n), sizeof(CacheRecord));
 			}
 
-			//check foundation to tableau
-			//very rarely needed to solve optimally
-			pile1 = piles + FOUNDATION1;
+			pthread_mutex_unlock(&lock);
 
-			for (int i = FOUNDATION1; i <= FOUNDATION4; ++i, ++pile1) {
-				int foundationSize = pile1->size;
+			if (n < 0) {
+				return false;
+			}
 
-				if (foundationSize == 0) {
-					continue;
-				}
+			to->pack[sizeof(to->pack) - 1] = 0;
+			swapPack(to->pack, swap);
+			return true;
+		}
+		//store a result for a deal, record only needs its status, moves, found, ms, nodes and pack filled in.
+		//a deal that is already there is left alone
+		void add(const Card* cards, int drawCount, CacheRecord* record) {
+			int swap = canonical(cards, record->cards);
+			record->drawCount = drawCount;
+			swapPack(record->pack, swap);
+			pthread_mutex_lock(&lock);
+
+			if (lookup(record->cards, drawCount) < 0) {
+				refresh();
+			}
 
-				card1 = pile1->cards[foundationSize - 1];
-				int min = (card1->clr == 0 ? redMin : blackMin) + 2;
+			if (lookup(record->cards, drawCount) < 0) {
+				keep(record);
 
-				if (card1->rank <= min) {
-					continue;
+				if (write(fd, record, sizeof(CacheRecord)) != sizeof(CacheRecord)) {
+					fprintf(stderr, "Could not add a deal to the solution cache\n");
 				}
+			}
 
-				pile2 = piles + TABLEAU1;
+			pthread_mutex_unlock(&lock);
+		}
+};
 
-				for (int j = TABLEAU1; j <= TABLEAU7; ++j, ++pile2) {
-					int size = pile2->size;
+//settings used for every deal solved in a run
+struct SolveOptions {
+	int searchThreads; //threads used to search a single deal
+	int drawCount; //cards turned over from the stock at a time
+	int memory; //megabytes each deal's search may use, 0 for no limit
+	FILE* statsFile; //where a JSON record of search statistics is written for every deal, NULL for none
+	FILE* output; //where the record of every deal is printed
+	bool fast; //use solveFast instead of solve
+	bool prove; //run prove first and skip the search of deals it shows cannot be won
+	bool proveOnly; //run prove instead of the search
+	bool suitSwaps; //let positions with the suits of a colour traded share a closed set entry
+	SolveLimits limits; //applied to the search of each deal
+	const PatternFile* patterns; //pattern tables added to minWinAt, NULL for none
+	SolutionCache* cache; //where results are looked up before searching and stored after, NULL for none
+	Checkpoint checkpoint; //for the search of each deal, in batch mode the file name gets a dot and the line number
+
+	SolveOptions() {
+		searchThreads = 1;
+		drawCount = 1;
+		memory = 0;
+		statsFile = NULL;
+		output = stdout;
+		fast = false;
+		prove = false;
+		proveOnly = false;
+		suitSwaps = false;
+		limits = SolveLimits();
+		patterns = NULL;
+		cache = NULL;
+		checkpoint = Checkpoint();
+		checkpoint.seconds = 300;
+	}
+};
 
-					if (size != 0) {
-						Card* card = pile2->cards[size - 1];
+//a deck read from a batch file along with the result of solving it
+struct Deal {
+	int line, digits;
+	char cardSet[156];
+	int moves, found, ms;
+	char* pack; //packed solution, NULL if not solved
+	char* stats; //search statistics as JSON, NULL if not wanted
+	bool done, capped; //capped is set when the search stopped at its memory limit
+	SolveStop stop; //why the search ended
+	bool proven; //prove showed the deal cannot be won
+
+	Deal() {
+		line = 0;
+		digits = 0;
+		pack = NULL;
+		stats = NULL;
+		clear();
+	}
+	~Deal() {
+		delete []pack;
+		delete []stats;
+	}
 
-						if (!card->up || card->rank - card1->rank != 1 || card->clr == card1->clr) {
-							continue;
-						}
+	//forget the result so the deal can be reused for the next line
+	void clear() {
+		moves = 0;
+		found = 0;
+		ms = 0;
+		delete []pack;
+		delete []stats;
+		pack = NULL;
+		stats = NULL;
+		done = false;
+		capped = false;
+		stop = STOP_EXHAUSTED;
+		proven = false;
+	}
+};
 
-						mvs->addLast(i, j, 1, 0);
-						continue;
-					}
+//solve a deal with the given solver and store the result in the deal
+void solveDeal(Solitaire* s, Deal* deal, SolveOptions* options) {
+	if (deal->digits != 156 || !s->load(deal->cardSet)) {
+		deal->found = -1;
+		return;
+	}
 
-					if (card1->rank != 12) {
-						continue;
-					}
+	timeb startTime;
+	ftime(&startTime);
+	CacheRecord record;
+
+	if (options->cache != NULL && options->cache->find(s->dealCards(), options->drawCount, &record)) {
+		deal->moves = record.moves;
+		deal->found = record.found;
+		deal->proven = record.status == CACHE_UNSOLVABLE;
+		deal->stop = deal->proven ? STOP_EXHAUSTED : STOP_SOLVED;
+		deal->ms = elapsed(&startTime);
+
+		if (!deal->proven) {
+			deal->pack = new char[strlen(record.pack) + 1];
+			strcpy(deal->pack, record.pack);
+		}
 
-					mvs->addLast(i, j, 1, 0);
-					break;
-				}
-			}
+		if (options->statsFile != NULL) {
+			deal->stats = new char[96];
+			snprintf(deal->stats, 96, "{\"cached\":{\"ms\":%i,\"nodes\":%lld}}", record.ms, record.nodes);
+		}
 
-			//check cards waiting to be turned over from stock
-			pile1 = piles + STOCK;
+		return;
+	}
 
-			for (int j = stockSize - 1; j >= 0; --j) {
-				card1 = pile1->cards[j];
-				int stockFoundation = 9 + card1->suit;
+	deal->moves = s->minWinAt();
+	int proof = 1;
 
-				if (card1->rank - piles[stockFoundation].topRank() == 1) {
-					int min = (card1->clr == 0 ? redMin : blackMin) + 2;
+	if (options->prove || options->proveOnly) {
+		proof = s->prove(false, options->memory, &options->limits);
+		deal->proven = proof == 0;
+	}
 
-					if (card1->rank <= min) {
-						mvs->addLast(WASTE, stockFoundation, 1, stockSize - j);
-						return;
-					}
+	if (options->proveOnly || proof == 0) {
+		deal->found = proof == 1 ? 52 : s->result.bestF;
+		deal->moves = proof == 1 ? s->result.moves : 0;
+	} else if (options->fast) {
+		deal->found = s->solveFast(&deal->moves, false, options->memory, &options->limits);
+	} else {
+		char filename[1024];
+		Checkpoint checkpoint = options->checkpoint;
+
+		if (checkpoint.filename != NULL) {
+			snprintf(filename, sizeof(filename), "%s.%i", options->checkpoint.filename, deal->line);
+			checkpoint.filename = filename;
+		}
 
-					mvs->addLast(WASTE, stockFoundation, 1, stockSize - j);
-				}
+		deal->found = s->solve(&deal->moves, false, options->searchThreads, options->memory, &options->limits, &checkpoint);
+	}
 
-				pile2 = piles + TABLEAU1;
+	deal->ms = elapsed(&startTime);
+	deal->stop = s->result.stop;
+	deal->capped = deal->found != 52 && s->memoryFull;
 
-				for (int i = TABLEAU1; i <= TABLEAU7; ++i, ++pile2) {
-					int size = pile2->size;
+	if (deal->found == 52) {
+		deal->pack = s->solution.packed(options->drawCount);
+	}
 
-					if (size != 0) {
-						Card* card = pile2->cards[size - 1];
+	if (options->statsFile != NULL) {
+		deal->stats = s->stats.json();
+	}
 
-						if (!card->up || card->rank - card1->rank != 1 || card->clr == card1->clr) {
-							continue;
-						}
+	//only shortest solutions are kept, not ones from the fast search or prove
+	bool shortest = deal->found == 52 && !options->fast && !options->proveOnly && strlen(deal->pack) < sizeof(record.pack);
+
+	if (options->cache != NULL && (deal->proven || shortest)) {
+		record.status = deal->proven ? CACHE_UNSOLVABLE : CACHE_SOLVED;
+		record.moves = deal->moves;
+		record.found = deal->found;
+		record.ms = deal->ms;
+		record.nodes = s->result.nodes;
+		strcpy(record.pack, deal->proven ? "" : deal->pack);
+		options->cache->add(s->dealCards(), options->drawCount, &record);
+	}
+}
 
-						mvs->addLast(WASTE, i, 1, stockSize - j);
-						continue;
-					}
+const char* dealStatus(Deal* deal) {
+	if (deal->found < 0) {
+		return "invalid";
+	}
 
-					if (card1->rank != 12) {
-						continue;
-					}
+	if (deal->found == 52) {
+		return "solved";
+	}
 
-					mvs->addLast(WASTE, i, 1, stockSize - j);
-					break;
-				}
-			}
+	if (deal->proven) {
+		return "unsolvable";
+	}
 
-			//check cards already turned over in the waste
-			//meaning we have to "redeal" the deck to get to it
-			pile1 = piles + WASTE;
-			--wasteSize;
+	if (deal->stop == STOP_CANCELLED) {
+		return "cancelled";
+	}
 
-			for (int j = 0; j < wasteSize; ++j) {
-				card1 = pile1->cards[j];
-				int stockFoundation = 9 + card1->suit;
+	if (deal->stop == STOP_NODES || deal->stop == STOP_TIME) {
+		return "limit";
+	}
 
-				if (card1->rank - piles[stockFoundation].topRank() == 1) {
-					int min = (card1->clr == 0 ? redMin : blackMin) + 2;
+	return deal->capped ? "capped" : "unsolved";
+}
 
-					if (card1->rank <= min) {
-						mvs->addLast(WASTE, stockFoundation, 1, stockSize + j + 1);
-						return;
-					}
+//writes one line of JSON with the result of a deal and the statistics of its search
+void printStats(FILE* f, Deal* deal) {
+	fprintf(f, "{\"line\":%i,\"status\":\"%s\",\"moves\":%i,\"found\":%i,\"ms\":%i,\"stats\":%s}\n",
+		deal->line, dealStatus(deal), deal->moves, deal->found, deal->ms, deal->stats != NULL ? deal->stats : "null");
+	fflush(f);
+}
 
-					mvs->addLast(WASTE, stockFoundation, 1, stockSize + j + 1);
-				}
+//prints one record per deck: line status moves foundation milliseconds packed-solution
+void printDeal(Deal* deal, SolveOptions* options) {
+	if (deal->found < 0) {
+		fprintf(options->output, "%i invalid 0 0 0 -\n", deal->line);
+	} else {
+		fprintf(options->output, "%i %s %i %i %i %s\n", deal->line, dealStatus(deal), deal->moves, deal->found, deal->ms,
+			deal->pack != NULL ? deal->pack : "-");
+	}
 
-				pile2 = piles + TABLEAU1;
+	fflush(options->output);
 
-				for (int i = TABLEAU1; i <= TABLEAU7; ++i, ++pile2) {
-					int size = pile2->size;
+	if (options->statsFile != NULL) {
+		printStats(options->statsFile, deal);
+	}
+}
 
-					if (size != 0) {
-						Card* card = pile2->cards[size - 1];
+//deque of deals waiting to be solved. the owning worker takes from the front and idle workers steal from the back
+class DealQueue {
+	private:
+		Deal** items;
+		int capacity, head;
+		pthread_mutex_t lock;
+	public:
+		int count;
 
-						if (!card->up || card->rank - card1->rank != 1 || card->clr == card1->clr) {
-							continue;
-						}
+		DealQueue() {
+			capacity = 64;
+			head = 0;
+			count = 0;
+			items = new Deal*[capacity];
+			pthread_mutex_init(&lock, NULL);
+		}
+		~DealQueue() {
+			delete []items;
+			pthread_mutex_destroy(&lock);
+		}
 
-						mvs->addLast(WASTE, i, 1, stockSize + j + 1);
-						continue;
-					}
+		void push(Deal* deal) {
+			pthread_mutex_lock(&lock);
 
-					if (card1->rank != 12) {
-						continue;
-					}
+			if (count == capacity) {
+				Deal** larger = new Deal*[capacity << 1];
 
-					mvs->addLast(WASTE, i, 1, stockSize + j + 1);
-					break;
+				for (int i = 0; i < count; ++i) {
+					larger[i] = items[(head + i) % capacity];
 				}
+
+				delete []items;
+				items = larger;
+				head = 0;
+				capacity <<= 1;
 			}
+
+			items[(head + count++) % capacity] = deal;
+			pthread_mutex_unlock(&lock);
 		}
-		//set minimum ranks in foundation
-		void setFoundationMin() {
-			int one = piles[FOUNDATION2].topRank();
-			int two = piles[FOUNDATION4].topRank();
-			redMin = one <= two ? one : two;
-			one = piles[FOUNDATION1].topRank();
-			two = piles[FOUNDATION3].topRank();
-			blackMin = one <= two ? one : two;
+		Deal* pop() {
+			Deal* deal = NULL;
+			pthread_mutex_lock(&lock);
+
+			if (count > 0) {
+				deal = items[head];
+				head = (head + 1) % capacity;
+				--count;
+			}
+
+			pthread_mutex_unlock(&lock);
+			return deal;
 		}
-		//heuristic function used to determine lower bound of moves needed
-		int minWinAt() {
-			int win = (piles[STOCK].size << 1) + piles[WASTE].size; //needs to modified slightly for draw counts greater than 1
-			Card* ctmp1, *ctmp2;
-			Pile* p = piles + WASTE;
-			
-			for (int i = p->size - 1; i >= 0; --i) {
-				ctmp1 = p->cards[i];
-				
-				for (int j = i - 1; j >= 0; --j) {
-					ctmp2 = p->cards[j];
+		Deal* steal() {
+			Deal* deal = NULL;
+			pthread_mutex_lock(&lock);
 
-					if (ctmp1->suit == ctmp2->suit && ctmp1->rank > ctmp2->rank) {
-						++win;
-						break;
-					}
-				}
+			if (count > 0) {
+				deal = items[(head + --count) % capacity];
 			}
 
-			p = piles + TABLEAU1;
+			pthread_mutex_unlock(&lock);
+			return deal;
+		}
+};
 
-			for (int i = TABLEAU1; i <= TABLEAU7; ++i, ++p) {
-				int temp = p->size;
-				int top = p->top < 0 ? temp : p->top;
-				win += temp + top;
+//reader -> workers -> writer pipeline used to solve a batch of deals on several threads.
+//the reader hands deals out round robin, each worker owns a solver and steals from the others when it runs dry,
+//and the writer prints the results in the same order the deals were read.
+class DealPipeline {
+	private:
+		FILE* file;
+		SolveOptions* options;
+		int workers;
+		DealQueue* queues;
+		Deal** deals; //ring of every deal read and not yet printed, in read order
+		int dealsCapacity, read, written, nextWorker;
+		bool eof;
+		pthread_mutex_t lock;
+		pthread_cond_t workReady, dealDone, dealWritten;
+
+		struct WorkerArg {
+			DealPipeline* pipeline;
+			int id;
+		};
+
+		static void* readerMain(void* arg) {
+			((DealPipeline*)arg)->reader();
+			return NULL;
+		}
+		static void* workerMain(void* arg) {
+			WorkerArg* w = (WorkerArg*)arg;
+			w->pipeline->worker(w->id);
+			return NULL;
+		}
 
-				while ((--temp) >= 0) {
-					ctmp1 = p->cards[temp];
+		void reader() {
+			int line = 0;
+			Deal* deal = new Deal();
 
-					for (int j = (top < temp ? top - 1 : temp - 1); j >= 0; --j) {
-						ctmp2 = p->cards[j];
+			while ((deal->digits = readDeckLine(file, deal->cardSet)) >= 0) {
+				deal->line = ++line;
 
-						if (ctmp1->suit == ctmp2->suit && ctmp1->rank > ctmp2->rank) {
-							++win;
+				if (deal->digits == 0) {
+					continue;
+				}
 
-							if (top < temp) {
-								temp = top;
-							}
+				pthread_mutex_lock(&lock);
 
-							break;
-						}
-					}
+				//do not read too far ahead of the writer
+				while (read - written >= dealsCapacity) {
+					pthread_cond_wait(&dealWritten, &lock);
 				}
-			}
 
-			return win;
-		}
-		int shuffle(int seed = -1) {
-			if (seed != -1) {
-				random.setSeed(seed);
-			} else {
-				seed = random.next();
-				random.setSeed(seed);
+				deals[read++ % dealsCapacity] = deal;
+				queues[nextWorker].push(deal);
+				nextWorker = (nextWorker + 1) % workers;
+				pthread_cond_broadcast(&workReady);
+				pthread_mutex_unlock(&lock);
+				deal = new Deal();
 			}
 
-			int temp;
+			delete deal;
+			pthread_mutex_lock(&lock);
+			eof = true;
+			pthread_cond_broadcast(&workReady);
+			pthread_cond_broadcast(&dealDone);
+			pthread_mutex_unlock(&lock);
+		}
+		Deal* findWork(int id) {
+			Deal* deal = queues[id].pop();
 
-			for (int x = 0; x < 250; ++x) {
-				int k = random.next() % 52;
-				int j = random.next() % 52;
-				temp = cards[k].value;
-				cards[k].set(cards[j].value);
-				cards[j].set(temp);
+			for (int i = 1; deal == NULL && i < workers; ++i) {
+				deal = queues[(id + i) % workers].steal();
 			}
 
-			reset();
-			return seed;
+			return deal;
 		}
-		bool load(char* cardSet) {
-			for (int i = 0; i < 52; i++) {
-				int suit = (cardSet[i * 3 + 2] ^ 0x30) - 1;
+		void worker(int id) {
+			Solitaire s = Solitaire(options->drawCount);
+			s.usePatterns(options->patterns);
+			s.useSuitSwaps(options->suitSwaps);
 
-				if (suit < 0 || suit > 3) {
-					return false;
-				}
+			while (true) {
+				Deal* deal = findWork(id);
 
-				if (suit >= 2) {
-					suit = (suit == 2) ? 3 : 2;
+				if (deal == NULL) {
+					pthread_mutex_lock(&lock);
+
+					while ((deal = findWork(id)) == NULL && !eof) {
+						pthread_cond_wait(&workReady, &lock);
+					}
+
+					pthread_mutex_unlock(&lock);
+
+					if (deal == NULL) {
+						return;
+					}
 				}
 
-				int rank = (cardSet[i * 3] ^ 0x30) * 10 + (cardSet[i * 3 + 1] ^ 0x30) - 1;
+				solveDeal(&s, deal, options);
+				pthread_mutex_lock(&lock);
+				deal->done = true;
+				pthread_cond_broadcast(&dealDone);
+				pthread_mutex_unlock(&lock);
+			}
+		}
+		void writer() {
+			pthread_mutex_lock(&lock);
+
+			while (true) {
+				while (written < read && deals[written % dealsCapacity]->done) {
+					Deal* deal = deals[written++ % dealsCapacity];
+					pthread_cond_signal(&dealWritten);
+					pthread_mutex_unlock(&lock);
+					printDeal(deal, options);
+					delete deal;
+					pthread_mutex_lock(&lock);
+				}
 
-				if (rank < 0 || rank > 12) {
-					return false;
+				if (eof && written == read) {
+					break;
 				}
 
-				cards[i].set(suit * 13 + rank);
+				pthread_cond_wait(&dealDone, &lock);
 			}
 
-			reset();
-			return true;
+			pthread_mutex_unlock(&lock);
 		}
-		void print() {
-			for (int i = 0; i < 13; i++) {
-				printf("%2i: ", i);
-				piles[i].print();
-				printf("\n");
-				fflush(stdout);
+	public:
+		DealPipeline(FILE* file, int workers, SolveOptions* options) {
+			this->file = file;
+			this->options = options;
+			this->workers = workers;
+			queues = new DealQueue[workers];
+			dealsCapacity = workers * 64;
+			deals = new Deal*[dealsCapacity];
+			read = 0;
+			written = 0;
+			nextWorker = 0;
+			eof = false;
+			pthread_mutex_init(&lock, NULL);
+			pthread_cond_init(&workReady, NULL);
+			pthread_cond_init(&dealDone, NULL);
+			pthread_cond_init(&dealWritten, NULL);
+		}
+		~DealPipeline() {
+			delete []queues;
+			delete []deals;
+			pthread_mutex_destroy(&lock);
+			pthread_cond_destroy(&workReady);
+			pthread_cond_destroy(&dealDone);
+			pthread_cond_destroy(&dealWritten);
+		}
+
+		void run() {
+			pthread_t readerThread;
+			pthread_t* workerThreads = new pthread_t[workers];
+			WorkerArg* args = new WorkerArg[workers];
+			pthread_create(&readerThread, NULL, readerMain, this);
+
+			for (int i = 0; i < workers; ++i) {
+				args[i].pipeline = this;
+				args[i].id = i;
+				pthread_create(workerThreads + i, NULL, workerMain, args + i);
 			}
 
-			moves.print();
-			printf("\nMinWinAt: %i\n", minWinAt());
-			fflush(stdout);
+			//the calling thread is the writer
+			writer();
+			pthread_join(readerThread, NULL);
+
+			for (int i = 0; i < workers; ++i) {
+				pthread_join(workerThreads[i], NULL);
+			}
+
+			delete []workerThreads;
+			delete []args;
 		}
-		//IDA* implementation to solve specified deal
-		int solve(int* max, bool show = false) {
-			int bestF = 0, mm = *max;
-			HashMap closed = HashMap(23);
-			reset();
-			int wa = minWinAt(), added = 0;
-			closed.addGet(key(), wa);
-			MoveList mList = MoveList();
-			MoveList mList2 = MoveList();
-			MoveArray open = MoveArray(1 << 23);
-			open.add(-1, -1, -1, wa << 12);
-
-			while (open.top > 0) {
-				//grab first move and move it to the end so it can be cleaned up later.
-				int parent = open.moveFirstToLast();
-				Move* temp = open.get(parent);
-				reset();
-				mList.clear();
-				wa = 0;
-
-				//generate move list
-				while (temp->cards >= 0) {
-					mList.addFirst(temp->from, temp->to, temp->cards, temp->val & 31);
-					wa += (temp->val & 31) + 1;
-					temp = temp->prev;
-				}
-
-				//make all moves
-				if (mList.first != NULL) {
-					makeMove(mList.first);
-				}
-
-				//check and see if the game is won
-				if (foundationCount > bestF || (foundationCount == 52 && wa <= mm)) {
-					bestF = foundationCount;
-
-					if (bestF == 52 && wa <= mm) {
-						if (show) {
-							mList.printPacked();
-							printf("\n");
-							mList.printPretty();
-							printf("\n");
-							fflush(stdout);
-						}
-						*max = wa;
-						return 52;
-					}
-				}
-
-				//update list of available moves
-				updateMoves(&moves);
-				//check each of the available moves to see if it has been evaluated already or not
-				temp = moves.first;
-				added = 0;
-				int flipped;
-				while (temp != NULL) {
-					mList2.clear();
-					bool thru = makeMove(temp->from, temp->to, temp->cards, temp->val);
-					flipped = 1;
-					/*bool easy = true;
-					while (easy) {
-						updateMoves(&mList3, false);
-						easy = mList3.size == 1;
-						if (easy) {
-							++flipped;
-							makeMove(mList3.first->from, mList3.first->to, mList3.first->cards, 0);
-							mList2.addFirst(mList3.first->from, mList3.first->to, mList3.first->cards, 0);
-						}
-					}*/
-
-					bool easy = true;
-					while (easy) {
-						easy = false;
-
-						Pile* pile = piles + WASTE;
-						int wasteSize = pile->size;
-						if (wasteSize > 0) {
-							Card* card = pile->cards[wasteSize - 1];
-							int wasteFoundation = 9 + card->suit;
-
-							if (card->rank - piles[wasteFoundation].topRank() == 1) {
-								int min = (card->clr == 0 ? redMin : blackMin) + 2;
-
-								if (card->rank <= min) {
-									++flipped;
-									makeMove(WASTE, wasteFoundation, 1, 0);
-									mList2.addFirst(WASTE, wasteFoundation, 1, 0);
-									easy = true;
-								}
-							}
-						}
+};
 
-						pile = piles + TABLEAU1;
-						for (int i = TABLEAU1; i <= TABLEAU7; ++i, ++pile) {
-							int pile1Size = pile->size;
+//solve every deck in the file, one deck per line. with one thread the same solver is reused for every deck,
+//with more each worker thread reuses its own.
+void solveBatch(FILE* f, int threads, SolveOptions* options) {
+	if (threads > 1) {
+		DealPipeline pipeline = DealPipeline(f, threads, options);
+		pipeline.run();
+		return;
+	}
 
-							if (pile1Size == 0) {
-								continue;
-							}
+	Solitaire s = Solitaire(options->drawCount);
+	s.usePatterns(options->patterns);
+	s.useSuitSwaps(options->suitSwaps);
+	Deal deal = Deal();
+	int line = 0;
 
-							Card* card = pile->cards[pile1Size - 1];
+	while ((deal.digits = readDeckLine(f, deal.cardSet)) >= 0) {
+		deal.line = ++line;
 
-							if (!card->up) {
-								++flipped;
-								makeMove(i, i, 0, 0);
-								mList2.addFirst(i, i, 0, 0);
-								easy = true;
-								break;
-							}
+		if (deal.digits == 0) {
+			continue;
+		}
 
-							int cardFoundation = 9 + card->suit;
+		deal.clear();
+		solveDeal(&s, &deal, options);
+		printDeal(&deal, options);
+	}
+}
 
-							if (card->rank - piles[cardFoundation].topRank() == 1) {
-								int min = (card->clr == 0 ? redMin : blackMin) + 2;
+//build the pattern table of every deck in the file, one deck per line, and write them to out.
+//returns the number of decks read or -1 if out could not be written
+int makePatterns(FILE* f, const char* out) {
+	Solitaire s = Solitaire(1);
+	Deal deal = Deal();
+	int capacity = 64, count = 0;
+	PatternEntry* entries = new PatternEntry[capacity];
 
-								if (card->rank <= min) {
-									++flipped;
-									makeMove(i, cardFoundation, 1, 0);
-									mList2.addFirst(i, cardFoundation, 1, 0);
-									easy = true;
-									break;
-								}
-							}
-						}
-					}
-					int mvs = wa + temp->val + flipped;// + minWinAt();
+	while ((deal.digits = readDeckLine(f, deal.cardSet)) >= 0) {
+		if (deal.digits != 156 || !s.load(deal.cardSet)) {
+			continue;
+		}
 
-					//only add moves with length less than current iteration depth
-					if (mvs + minWinAt() <= mm) {
-						Pair* p = closed.addGet(key(), mvs);
-						++added;
+		if (count == capacity) {
+			PatternEntry* larger = new PatternEntry[capacity << 1];
+			memcpy(larger, entries, count * sizeof(PatternEntry));
+			delete []entries;
+			entries = larger;
+			capacity <<= 1;
+		}
 
-						//only add new moves or moves with fewer total moves (should just reupdate the existing move's parent, but havent got to it)
-						if (p == NULL || p->value > mvs) {
-							open.add(temp->from, temp->to, temp->cards, ((52 - foundationCount + rounds) << 5) | temp->val, parent);
+		s.downCards(entries[count].down);
+		PatternFile::build(entries + count++);
+	}
 
-							if (flipped > 1) {
-								Move* mv = mList2.last;
-								while (mv != NULL) {
-									open.add(mv->from, mv->to, mv->cards, ((52 - foundationCount + rounds) << 5), open.moveFirstToLast());
-									mv = mv->prev;
-								}
-							}
+	bool written = PatternFile::write(out, entries, count);
+	delete []entries;
+	return written ? count : -1;
+}
 
-							if (p != NULL) {
-								p->value = mvs;
-							}
-						}
-					}
+//bench.cpp includes this file for its own main
+#ifndef KLONDIKE_NO_MAIN
+std::atomic<bool> interrupted(false);
 
-					if (flipped > 1) {
-						Move* mv = mList2.first;
-						while (mv != NULL) {
-							undoMove(mv->from, mv->to, mv->cards, 0, false);
-							mv = mv->next;
-						}
-					}
-					undoMove(temp->from, temp->to, temp->cards, temp->val, thru);
-					temp = temp->next;
-				}
+//the first ctrl-c or SIGTERM cancels the searches still running so their results are printed and their checkpoints
+//saved, a second one quits
+void interrupt(int sig) {
+	interrupted.store(true);
+	signal(sig, SIG_DFL);
+}
 
-				//if all branches from this parent have been added mark this move as no longer needed if we reopen the search
-				if (added == moves.size) {
-					open.setUsed(parent);
-				}
+int main(int argc, char * argv[]) {
+	SolveOptions options = SolveOptions();
+	options.limits.cancel = &interrupted;
+	signal(SIGINT, interrupt);
+	signal(SIGTERM, interrupt);
+	const char* filename = NULL, *patternsOut = NULL;
+	bool batch = false;
+	int threads = 1;
+	PatternFile patterns = PatternFile();
+	SolutionCache cache = SolutionCache();
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--batch") == 0) {
+			batch = true;
+		} else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			threads = atoi(argv[++i]);
+
+			if (threads <= 0) {
+				threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+			}
+		} else if (strcmp(argv[i], "--search-threads") == 0 && i + 1 < argc) {
+			options.searchThreads = atoi(argv[++i]);
 
-				//reopen the search if we have not found a solution for the next higher depth
-				if (open.top == 0 && bestF < 52) {
-					if ((++mm) > 256) {
-						return bestF;
-					}
+			if (options.searchThreads <= 0) {
+				options.searchThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+			}
+		} else if (strcmp(argv[i], "--draw") == 0 && i + 1 < argc) {
+			options.drawCount = atoi(argv[++i]);
 
-					*max = mm;
-					int prevSize = open.size;
-					open.prune();
+			if (options.drawCount < 1 || options.drawCount > 24) {
+				fprintf(stderr, "Draw count must be between 1 and 24\n");
+				return -1;
+			}
+		} else if (strcmp(argv[i], "--fast") == 0) {
+			options.fast = true;
+		} else if (strcmp(argv[i], "--prove") == 0) {
+			options.prove = true;
+		} else if (strcmp(argv[i], "--prove-only") == 0) {
+			options.proveOnly = true;
+		} else if (strcmp(argv[i], "--suit-swaps") == 0) {
+			options.suitSwaps = true;
+		} else if (strcmp(argv[i], "--nodes") == 0 && i + 1 < argc) {
+			options.limits.nodes = atoll(argv[++i]);
+		} else if (strcmp(argv[i], "--time") == 0 && i + 1 < argc) {
+			options.limits.ms = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--mem") == 0 && i + 1 < argc) {
+			options.memory = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--patterns") == 0 && i + 1 < argc) {
+			if (!patterns.open(argv[++i])) {
+				fprintf(stderr, "Could not open pattern file %s\n", argv[i]);
+				return -1;
+			}
 
-					if (show) {
-						printf("Trying: %i OPS: %i OS-OT: %i-%i CS: %i F: %i\n", mm, prevSize, open.size, open.top, closed.size(), bestF);
-						fflush(stdout);
-					}
-				}
+			options.patterns = &patterns;
+		} else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+			if (!cache.open(argv[++i])) {
+				fprintf(stderr, "Could not open solution cache %s\n", argv[i]);
+				return -1;
 			}
 
-			if (show) {
-				printf("Failed. OS-OT: %i-%i CS: %i F: %i\n", open.size, open.top, closed.size(), bestF);
-				fflush(stdout);
+			options.cache = &cache;
+		} else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+			options.checkpoint.filename = argv[++i];
+		} else if (strcmp(argv[i], "--resume") == 0 && i + 1 < argc) {
+			options.checkpoint.filename = argv[++i];
+			options.checkpoint.resume = true;
+		} else if (strcmp(argv[i], "--checkpoint-every") == 0 && i + 1 < argc) {
+			options.checkpoint.seconds = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--make-patterns") == 0 && i + 1 < argc) {
+			patternsOut = argv[++i];
+		} else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+			++i;
+			options.statsFile = strcmp(argv[i], "-") == 0 ? stdout : fopen(argv[i], "w");
+
+			if (options.statsFile == NULL) {
+				fprintf(stderr, "Could not open %s\n", argv[i]);
+				return -1;
 			}
+		} else {
+			filename = argv[i];
+		}
+	}
+
+	if (batch || patternsOut != NULL) {
+		FILE* f = filename == NULL || strcmp(filename, "-") == 0 ? stdin : fopen(filename, "r");
 
-			return bestF;
+		if (f == NULL) {
+			fprintf(stderr, "Could not open %s\n", filename);
+			return -1;
 		}
-};
 
-int main(int argc, char * argv[]) {
-	Solitaire s = Solitaire(1);
+		if (patternsOut != NULL) {
+			int count = makePatterns(f, patternsOut);
+
+			if (f != stdin) {
+				fclose(f);
+			}
+
+			if (count < 0) {
+				fprintf(stderr, "Could not write %s\n", patternsOut);
+				return -1;
+			}
+
+			printf("Wrote the pattern tables of %i decks to %s\n", count, patternsOut);
+			return 0;
+		}
+
+		solveBatch(f, threads, &options);
+
+		if (f != stdin) {
+			fclose(f);
+		}
+
+		if (options.statsFile != NULL && options.statsFile != stdout) {
+			fclose(options.statsFile);
+		}
+
+		return 0;
+	}
+
+	Solitaire s = Solitaire(options.drawCount);
+	s.usePatterns(options.patterns);
+	s.useSuitSwaps(options.suitSwaps);
 	s.shuffle();
 	printf("Solitaire Solver 3.1 11/11/2011\n--------------------------------------------------------------------------------\n");
 	bool loaded = true;
 	int i = 0;
 
-	if (argc != 2)
+	if (filename == NULL)
 	{
-		fprintf(stderr, "%s\n",
-				"You must supply a command-line argument with the deck file."
-			   );
+		fprintf(stderr, "%s",
+			"usage: KlondikeSolver [options] deck-file\n"
+			"       KlondikeSolver --batch [file] [options]\n"
+			"  --batch [file]         solve one deck per line, from stdin without a file\n"
+			"  --threads n            solve batch decks on n threads, 0 for one per core\n"
+			"  --draw n               turn over n cards from the stock at a time\n"
+			"  --fast                 take the first solution found instead of the shortest\n"
+			"  --prove                first check the deal can be won at all\n"
+			"  --prove-only           only check the deal can be won\n"
+			"  --suit-swaps           let positions with a colour's suits traded share a closed set entry\n"
+			"  --nodes n              stop a search after n expanded positions\n"
+			"  --time ms              stop a search after ms milliseconds\n"
+			"  --search-threads n     search each deal on n threads, 0 for one per core\n"
+			"  --mem n                limit each deal's search to n megabytes\n"
+			"  --make-patterns out [file]  write the pattern tables of a batch file's decks to out\n"
+			"  --patterns file        use the pattern tables in file\n"
+			"  --cache file           keep batch results in file between runs\n"
+			"  --checkpoint file      save the search to file now and then and when it is stopped\n"
+			"  --checkpoint-every s   save the checkpoint every s seconds (300)\n"
+			"  --resume file          carry on from a saved checkpoint\n"
+			"  --stats file           write search statistics as JSON, - for stdout\n");
 		return -1;
 	}
-	char * filename = argv[1];
 
 	FILE* f = fopen(filename, "r");
 	char c1, c2 = ' ';
@@ -1710,14 +5359,42 @@ int main(int argc, char * argv[]) {
 	//for(int j = 0; j < 50; ++j) {
 		//s.shuffle();
 		i = s.minWinAt();
-		printf("Trying %i\n", i);
-		int x = s.solve(&i, true);
+		int x, proof = 1;
+
+		if (options.prove || options.proveOnly) {
+			proof = s.prove(options.proveOnly, options.memory, &options.limits);
+			printf("Winnable: %s\n", proof == 1 ? "yes" : (proof == 0 ? "no" : "unknown"));
+		}
+
+		if (options.proveOnly || proof == 0) {
+			x = proof == 1 ? 52 : s.result.bestF;
+			i = proof == 1 ? s.result.moves : 0;
+		} else {
+			printf("Trying %i\n", i);
+			x = options.fast ? s.solveFast(&i, true, options.memory, &options.limits) : s.solve(&i, true, options.searchThreads, options.memory, &options.limits, &options.checkpoint);
+		}
+
 		printf("Found: %i %i\n", i, x);
 	//}
-	timeb endTime;
-	ftime(&endTime);
-	i = (endTime.time - startTime.time) * 1000L + (endTime.millitm - startTime.millitm);
-	printf("Done %i\n", i);
+	int ms = elapsed(&startTime);
+	printf("Done %i\n", ms);
+
+	if (options.statsFile != NULL) {
+		Deal deal = Deal();
+		deal.line = 1;
+		deal.moves = i;
+		deal.found = x;
+		deal.ms = ms;
+		deal.capped = x != 52 && s.memoryFull;
+		deal.stop = s.result.stop;
+		deal.proven = proof == 0;
+		deal.stats = s.stats.json();
+		printStats(options.statsFile, &deal);
+
+		if (options.statsFile != stdout) {
+			fclose(options.statsFile);
+		}
+	}
 	/*
 	 * Pressing a key to terminate a program is obnoxious and non-UNIXy.
 	 */
@@ -1726,3 +5403,4 @@ int main(int argc, char * argv[]) {
 #endif
 	return 0;
 }
+#endif